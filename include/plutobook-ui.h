@@ -31,6 +31,9 @@ namespace plutobook {
     PLUTOBOOK_API void getSize(UIContext* ui, float& width, float& height);
     PLUTOBOOK_API bool loadUrl(UIContext* ui, std::string_view url);
     PLUTOBOOK_API bool update(UIContext* ui);
+    PLUTOBOOK_API void getUpdateStats(const UIContext* ui,
+                                      unsigned& restyledBoxes,
+                                      unsigned& relaidOutBoxes);
     PLUTOBOOK_API void output(UIContext* ui, FILE* fd);
     PLUTOBOOK_API void processMouseIn(UIContext* ui);
     PLUTOBOOK_API void processMouseOut(UIContext* ui);
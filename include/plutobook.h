@@ -991,6 +991,100 @@ PLUTOBOOK_API bool plutobook_write_to_pdf_stream(const plutobook_t* book, plutob
  */
 PLUTOBOOK_API bool plutobook_write_to_pdf_stream_range(const plutobook_t* book, plutobook_stream_write_callback_t callback, void* closure, unsigned int page_start, unsigned int page_end, int page_step);
 
+/**
+ * @brief Streams the entire document to a PDF stream one page at a time using a callback function.
+ *
+ * The pages are painted in batches of one page per render thread and written in order. The page
+ * boxes of each batch are freed afterwards, so the memory used by page layout is bounded by the
+ * batch rather than by the page count. The font subsets used by the written pages are kept by the
+ * PDF writer until the document is finished, so that memory grows with the number of distinct
+ * glyphs used.
+ *
+ * @param context A pointer to a `plutobook_t` object.
+ * @param callback A callback function used for writing the PDF stream.
+ * @param closure A user-defined pointer passed to the callback function for additional data.
+ * @return `true` on success, or `false` on failure.
+ */
+PLUTOBOOK_API bool plutobook_stream_to_pdf(const plutobook_t* book, plutobook_stream_write_callback_t callback, void* closure);
+
+/**
+ * @brief Streams a specified range of pages to a PDF stream one page at a time using a callback function.
+ *
+ * This behaves like `plutobook_stream_to_pdf`. Pages can only be streamed in ascending order, so
+ * `page_step` must be positive.
+ *
+ * @param context A pointer to a `plutobook_t` object.
+ * @param callback A callback function used for writing the PDF stream.
+ * @param closure A user-defined pointer passed to the callback function for additional data.
+ * @param page_start The first page in the range to be written (inclusive).
+ * @param page_end The last page in the range to be written (inclusive).
+ * @param page_step The increment used to advance through the pages in the range.
+ * @return `true` on success, or `false` on failure.
+ */
+PLUTOBOOK_API bool plutobook_stream_to_pdf_range(const plutobook_t* book, plutobook_stream_write_callback_t callback, void* closure, unsigned int page_start, unsigned int page_end, int page_step);
+
+/**
+ * @brief Returns the peak resident set size of the current process.
+ *
+ * @return The peak resident set size in bytes, or `0` if it is not available on this platform.
+ */
+PLUTOBOOK_API size_t plutobook_get_peak_memory_usage(void);
+
+/**
+ * @brief Returns the number of font lookups served by the process-wide font cache.
+ *
+ * The font cache and its fontconfig configuration are shared by all documents in the process.
+ *
+ * @return The number of font cache hits.
+ */
+PLUTOBOOK_API unsigned int plutobook_get_font_cache_hit_count(void);
+
+/**
+ * @brief Returns the number of font lookups that missed the process-wide font cache.
+ *
+ * @return The number of font cache misses.
+ */
+PLUTOBOOK_API unsigned int plutobook_get_font_cache_miss_count(void);
+
+/**
+ * @brief Sets the number of bytes the process-wide resource cache may hold.
+ *
+ * The cache keeps decoded images, fonts and style sheets across documents, evicting the least recently used ones
+ * first. Local files are reloaded when they change; remote resources are reused until they are evicted. The cache
+ * is disabled by default.
+ *
+ * @param capacity The budget in bytes, or `0` to disable and empty the cache.
+ */
+PLUTOBOOK_API void plutobook_set_resource_cache_capacity(size_t capacity);
+
+/**
+ * @brief Returns the number of bytes the process-wide resource cache may hold.
+ *
+ * @return The budget in bytes, or `0` if the cache is disabled.
+ */
+PLUTOBOOK_API size_t plutobook_get_resource_cache_capacity(void);
+
+/**
+ * @brief Returns the estimated number of bytes held by the process-wide resource cache.
+ *
+ * @return The size of the cache in bytes.
+ */
+PLUTOBOOK_API size_t plutobook_get_resource_cache_size(void);
+
+/**
+ * @brief Returns the number of resource loads served by the process-wide resource cache.
+ *
+ * @return The number of resource cache hits.
+ */
+PLUTOBOOK_API unsigned int plutobook_get_resource_cache_hit_count(void);
+
+/**
+ * @brief Returns the number of resources decoded while the process-wide resource cache was enabled.
+ *
+ * @return The number of resource cache misses.
+ */
+PLUTOBOOK_API unsigned int plutobook_get_resource_cache_miss_count(void);
+
 /**
  * @brief Writes the entire document to a PNG image file.
  *
@@ -1014,6 +1108,114 @@ PLUTOBOOK_API bool plutobook_write_to_png(const plutobook_t* book, const char* f
  */
 PLUTOBOOK_API bool plutobook_write_to_png_stream(const plutobook_t* book, plutobook_stream_write_callback_t callback, void* closure, int width, int height);
 
+/**
+ * @brief Sets the number of threads used to paint pages when writing PDF and PNG output.
+ *
+ * Pages are painted concurrently and written in order. The helper threads come from a process-wide pool that is
+ * started on first use and kept for later calls. The default of `1` paints everything on the calling thread.
+ *
+ * @param context A pointer to a `plutobook_t` object.
+ * @param count The number of render threads, or `0` to use one per hardware thread.
+ */
+PLUTOBOOK_API void plutobook_set_render_thread_count(plutobook_t* book, unsigned int count);
+
+/**
+ * @brief Gets the number of threads used to paint pages when writing PDF and PNG output.
+ *
+ * @param context A pointer to a `plutobook_t` object.
+ * @return The number of render threads, or `0` for one per hardware thread.
+ */
+PLUTOBOOK_API unsigned int plutobook_get_render_thread_count(const plutobook_t* book);
+
+/**
+ * @brief Sets whether pagination predicts the shrink-to-fit page scale instead of laying the document out twice.
+ *
+ * In single-pass mode the scale for documents wider than the page is predicted from their min-content width.
+ * This must be set before the document is paginated.
+ *
+ * @param context A pointer to a `plutobook_t` object.
+ * @param enable `true` to enable single-pass pagination.
+ */
+PLUTOBOOK_API void plutobook_set_single_pass_pagination(plutobook_t* book, bool enable);
+
+/**
+ * @brief Returns whether single-pass pagination is enabled.
+ *
+ * @param context A pointer to a `plutobook_t` object.
+ * @return `true` if single-pass pagination is enabled.
+ */
+PLUTOBOOK_API bool plutobook_get_single_pass_pagination(const plutobook_t* book);
+
+/**
+ * @brief Returns the number of full layout passes run on the current document.
+ *
+ * @param context A pointer to a `plutobook_t` object.
+ * @return The number of layout passes.
+ */
+PLUTOBOOK_API unsigned int plutobook_get_layout_count(const plutobook_t* book);
+
+/**
+ * @brief Returns the number of element styles taken from the matched-properties cache.
+ *
+ * @param context A pointer to a `plutobook_t` object.
+ * @return The number of cache hits.
+ */
+PLUTOBOOK_API unsigned int plutobook_get_style_cache_hit_count(const plutobook_t* book);
+
+/**
+ * @brief Returns the number of element styles that missed the matched-properties cache.
+ *
+ * @param context A pointer to a `plutobook_t` object.
+ * @return The number of cache misses.
+ */
+PLUTOBOOK_API unsigned int plutobook_get_style_cache_miss_count(const plutobook_t* book);
+
+/**
+ * @brief Returns the number of text items taken from the shaped-text cache.
+ *
+ * @param context A pointer to a `plutobook_t` object.
+ * @return The number of cache hits.
+ */
+PLUTOBOOK_API unsigned int plutobook_get_shape_cache_hit_count(const plutobook_t* book);
+
+/**
+ * @brief Returns the number of cacheable text items that missed the shaped-text cache.
+ *
+ * @param context A pointer to a `plutobook_t` object.
+ * @return The number of cache misses.
+ */
+PLUTOBOOK_API unsigned int plutobook_get_shape_cache_miss_count(const plutobook_t* book);
+
+/**
+ * @brief Returns the number of heap allocations made while shaping the text of the document.
+ *
+ * Each shaped text item costs at most three allocations; the rest is growth of the
+ * per-thread shaping scratch, which stops once the scratch fits the largest item.
+ *
+ * @param context A pointer to a `plutobook_t` object.
+ * @return The number of shaping allocations.
+ */
+PLUTOBOOK_API unsigned long long plutobook_get_shaping_allocation_count(const plutobook_t* book);
+
+/**
+ * @brief Returns the number of glyph runs the book has drawn to cairo for the current document.
+ *
+ * Adjacent runs with the same font and color are drawn as one. Text inside SVG clip paths,
+ * masks and patterns is drawn to a separate surface and is not counted.
+ *
+ * @param context A pointer to a `plutobook_t` object.
+ * @return The number of glyph draw calls.
+ */
+PLUTOBOOK_API unsigned long long plutobook_get_glyph_run_draw_count(const plutobook_t* book);
+
+/**
+ * @brief Returns the number of glyphs the book has drawn to cairo for the current document.
+ *
+ * @param context A pointer to a `plutobook_t` object.
+ * @return The number of glyphs drawn.
+ */
+PLUTOBOOK_API unsigned long long plutobook_get_glyph_draw_count(const plutobook_t* book);
+
 /**
  * @brief Sets a custom resource fetcher callback for the document.
  *
@@ -41,6 +41,71 @@ namespace plutobook {
     PLUTOBOOK_API void setGraphicsManager(GraphicsManager& manager);
     PLUTOBOOK_API GraphicsManager& graphicsManager();
 
+    /**
+     * @brief Returns the peak resident set size of the current process.
+     * @return The peak resident set size in bytes, or `0` if it is not
+     * available on this platform.
+     */
+    PLUTOBOOK_API size_t peakMemoryUsage();
+
+    /**
+     * @brief Returns the number of font lookups served by the process-wide
+     * font cache, which is shared by all documents.
+     * @return The number of font cache hits.
+     */
+    PLUTOBOOK_API uint32_t fontCacheHitCount();
+
+    /**
+     * @brief Returns the number of font lookups that had to query fontconfig
+     * because the process-wide font cache had no entry for them.
+     * @return The number of font cache misses.
+     */
+    PLUTOBOOK_API uint32_t fontCacheMissCount();
+
+    /**
+     * @brief Sets the number of bytes the process-wide resource cache may
+     * hold.
+     *
+     * The cache keeps the decoded images, fonts and style sheets loaded by
+     * any document for the documents that follow, evicting the least
+     * recently used ones first once the budget is reached. Identical content
+     * served from different URLs is decoded once. Local files are reloaded
+     * when they change; remote resources are reused until they are evicted.
+     * The cache is disabled by default.
+     *
+     * @param capacity The budget in bytes, or `0` to disable and empty the
+     * cache.
+     */
+    PLUTOBOOK_API void setResourceCacheCapacity(size_t capacity);
+
+    /**
+     * @brief Returns the number of bytes the process-wide resource cache may
+     * hold.
+     * @return The budget in bytes, or `0` if the cache is disabled.
+     */
+    PLUTOBOOK_API size_t resourceCacheCapacity();
+
+    /**
+     * @brief Returns the estimated number of bytes held by the process-wide
+     * resource cache.
+     * @return The size of the cache in bytes.
+     */
+    PLUTOBOOK_API size_t resourceCacheSize();
+
+    /**
+     * @brief Returns the number of resource loads served by the process-wide
+     * resource cache, by URL or by content.
+     * @return The number of resource cache hits.
+     */
+    PLUTOBOOK_API uint32_t resourceCacheHitCount();
+
+    /**
+     * @brief Returns the number of resources that had to be decoded while
+     * the process-wide resource cache was enabled.
+     * @return The number of resource cache misses.
+     */
+    PLUTOBOOK_API uint32_t resourceCacheMissCount();
+
     /**
      * This constant defines an index that is guaranteed to be greater than any
      * valid page count. It is typically used as a sentinel value to represent
@@ -1024,6 +1089,8 @@ namespace plutobook {
     };
 
     class Document;
+    class DisplayList;
+    class CairoGraphicsContext;
 
     /**
      * @brief Defines the different media types used for CSS @media queries.
@@ -1215,6 +1282,108 @@ namespace plutobook {
          */
         MediaType mediaType() const override { return m_mediaType; }
 
+        /**
+         * @brief Sets whether pagination predicts the shrink-to-fit page
+         * scale instead of laying the document out twice.
+         *
+         * Documents wider than the page are scaled down to fit it. By
+         * default the scale is measured by laying the document out at the
+         * page width, and the document is then laid out again at the scaled
+         * width. In single-pass mode the scale is predicted from the
+         * min-content width of the document, so that it is laid out only
+         * once. The second pass still runs if the prediction falls short.
+         * Content that overflows a clipped container counts towards the
+         * min-content width, so such documents may be scaled down where the
+         * default mode would leave them unscaled.
+         *
+         * This must be set before the document is paginated.
+         *
+         * @param enable `true` to enable single-pass pagination.
+         */
+        void setSinglePassPagination(bool enable) {
+            m_singlePassPagination = enable;
+        }
+
+        /**
+         * @brief Returns whether single-pass pagination is enabled.
+         * @return `true` if single-pass pagination is enabled.
+         */
+        bool singlePassPagination() const {
+            return m_singlePassPagination;
+        }
+
+        /**
+         * @brief Returns the number of full layout passes run on the
+         * current document.
+         * @return The number of layout passes.
+         */
+        uint32_t layoutCount() const;
+
+        /**
+         * @brief Returns the number of element styles the current document
+         * took from its matched-properties cache instead of running the
+         * cascade.
+         * @return The number of cache hits.
+         */
+        uint32_t styleCacheHitCount() const;
+
+        /**
+         * @brief Returns the number of element styles the current document
+         * had to compute because its matched-properties cache had no entry
+         * for them.
+         * @return The number of cache misses.
+         */
+        uint32_t styleCacheMissCount() const;
+
+        /**
+         * @brief Returns the number of text items the current document took
+         * from the shaped-text caches instead of shaping them again.
+         *
+         * Text set in system fonts is looked up in a cache shared by every
+         * document of the process, so it may hit on shapes made for another
+         * document. Text in @font-face fonts uses a cache of the document.
+         * @return The number of cache hits.
+         */
+        uint32_t shapeCacheHitCount() const;
+
+        /**
+         * @brief Returns the number of cacheable text items the current
+         * document had to shape because the shaped-text caches had no entry
+         * for them.
+         * @return The number of cache misses.
+         */
+        uint32_t shapeCacheMissCount() const;
+
+        /**
+         * @brief Returns the number of heap allocations made while shaping the
+         * text of the current document.
+         *
+         * Each shaped text item costs at most three allocations: its glyphs,
+         * its run list and the shape itself. Everything else counted here is
+         * growth of the per-thread shaping scratch, which stops once the
+         * scratch fits the largest item.
+         * @return The number of shaping allocations.
+         */
+        uint64_t shapingAllocationCount() const;
+
+        /**
+         * @brief Returns the number of glyph runs the book has drawn to cairo
+         * for the current document, across every render and write call.
+         *
+         * Adjacent runs with the same font and color are drawn as one. Text
+         * inside SVG clip paths, masks and patterns is drawn to a separate
+         * surface and is not counted.
+         * @return The number of glyph draw calls.
+         */
+        uint64_t glyphRunDrawCount() const;
+
+        /**
+         * @brief Returns the number of glyphs the book has drawn to cairo for
+         * the current document, across every render and write call.
+         * @return The number of glyphs drawn.
+         */
+        uint64_t glyphDrawCount() const;
+
         /**
          * @brief Returns the number of pages in the document.
          * @return The number of pages in the document.
@@ -1444,6 +1613,70 @@ namespace plutobook {
                         uint32_t pageEnd = kMaxPageCount,
                         int pageStep = 1) const;
 
+        /**
+         * @brief Streams a range of pages to a PDF file one page at a time.
+         *
+         * The pages are painted in batches of one page per render thread
+         * (see `setRenderThreadCount`) and handed to the PDF writer in
+         * order. The page boxes and margin boxes of each batch are then
+         * freed, so the memory used by page layout is bounded by the batch
+         * rather than by the page count. The font subsets used by the
+         * written pages are still kept by the PDF writer until the document
+         * is finished, so that memory grows with the number of distinct
+         * glyphs used. Cached page recordings are dropped as well. Querying
+         * or rendering pages afterwards paginates the document again.
+         *
+         * Pages can only be streamed in ascending order, so `pageStep` must
+         * be positive.
+         *
+         * @param filename The file path where the PDF document will be written.
+         * @param pageStart The first page in the range to be written
+         * (inclusive).
+         * @param pageEnd The last page in the range to be written (inclusive).
+         * @param pageStep The increment used to advance through pages in the
+         * range.
+         * @return `true` on success, or `false` on failure.
+         */
+        bool streamToPdf(const std::string& filename,
+                         uint32_t pageStart = kMinPageCount,
+                         uint32_t pageEnd = kMaxPageCount,
+                         int pageStep = 1) const;
+
+        /**
+         * @brief Streams a range of pages to a PDF output stream one page
+         * at a time.
+         * @param output The output stream where the PDF document will be
+         * written.
+         * @param pageStart The first page in the range to be written
+         * (inclusive).
+         * @param pageEnd The last page in the range to be written (inclusive).
+         * @param pageStep The increment used to advance through pages in the
+         * range.
+         * @return `true` on success, or `false` on failure.
+         */
+        bool streamToPdf(OutputStream& output,
+                         uint32_t pageStart = kMinPageCount,
+                         uint32_t pageEnd = kMaxPageCount,
+                         int pageStep = 1) const;
+
+        /**
+         * @brief Streams a range of pages to a PDF stream one page at a time
+         * using a callback function.
+         * @param callback A callback function used for writing the PDF stream.
+         * @param closure A user-defined pointer passed to the callback function
+         * for additional data.
+         * @param pageStart The first page in the range to be written
+         * (inclusive).
+         * @param pageEnd The last page in the range to be written (inclusive).
+         * @param pageStep The increment used to advance through pages in the
+         * range.
+         * @return `true` on success, or `false` on failure.
+         */
+        bool streamToPdf(plutobook_stream_write_callback_t callback,
+                         void* closure, uint32_t pageStart = kMinPageCount,
+                         uint32_t pageEnd = kMaxPageCount,
+                         int pageStep = 1) const;
+
         /**
          * @brief Writes the entire document to a PNG image file.
          * @param filename The file path where the PNG image will be written.
@@ -1483,6 +1716,30 @@ namespace plutobook {
         bool writeToPng(plutobook_stream_write_callback_t callback,
                         void* closure, int width = -1, int height = -1) const;
 
+        /**
+         * @brief Sets the number of threads used to paint pages in
+         * `writeToPdf` and image bands in `writeToPng`.
+         *
+         * Pages are painted concurrently and written to the output in
+         * order. The calling thread paints alongside helper threads taken
+         * from a process-wide pool, which are started on first use and
+         * kept for later calls. The default of `1` paints everything on
+         * the calling thread.
+         *
+         * @param count The number of render threads, or `0` to use one per
+         * hardware thread.
+         */
+        void setRenderThreadCount(unsigned count) {
+            m_renderThreadCount = count;
+        }
+
+        /**
+         * @brief Gets the number of threads used to paint pages.
+         * @return The number of render threads, or `0` for one per hardware
+         * thread.
+         */
+        unsigned renderThreadCount() const { return m_renderThreadCount; }
+
         /**
          * @brief Sets a custom resource fetcher to be used for fetching
          * external resources.
@@ -1513,6 +1770,13 @@ namespace plutobook {
         Document* buildIfNeeded() const;
         Document* layoutIfNeeded() const;
         Document* paginateIfNeeded() const;
+        Document* pageLayoutIfNeeded() const;
+        void invalidateLayout();
+
+        const DisplayList* pageDisplayList(uint32_t pageIndex) const;
+        void setDocumentInfo(PDFCanvas& canvas) const;
+        const DisplayList* documentDisplayList() const;
+        void addGlyphDrawCounts(const CairoGraphicsContext& context) const;
 
         PageSize m_pageSize;
         PageMargins m_pageMargins;
@@ -1521,6 +1785,13 @@ namespace plutobook {
         mutable bool m_needsBuild{true};
         mutable bool m_needsLayout{true};
         mutable bool m_needsPagination{true};
+        mutable bool m_hasPageLayout{false};
+
+        mutable float m_documentWidth{0};
+        mutable float m_documentHeight{0};
+
+        unsigned m_renderThreadCount{1};
+        bool m_singlePassPagination{false};
 
         std::string m_author;
         std::string m_subject;
@@ -1531,6 +1802,11 @@ namespace plutobook {
 
         ResourceFetcher* m_customResourceFetcher{nullptr};
         std::unique_ptr<Document> m_document;
+
+        mutable std::vector<std::unique_ptr<DisplayList>> m_pageDisplayLists;
+        mutable std::unique_ptr<DisplayList> m_documentDisplayList;
+        mutable uint64_t m_glyphRunDrawCount{0};
+        mutable uint64_t m_glyphDrawCount{0};
     };
 
     PLUTOBOOK_API int getWidth(const Document* doc);
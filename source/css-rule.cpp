@@ -346,15 +346,13 @@ ValPtr<CssImageValue> CssImageValue::create(Url value)
     return ValPtr(new CssImageValue(std::move(value)));
 }
 
-const RefPtr<Image>& CssImageValue::fetch(Document* document) const
+RefPtr<Image> CssImageValue::fetch(Document* document) const
 {
-    if(m_image == nullptr) {
-        if(auto imageResource = document->fetchImageResource(m_value)) {
-            m_image = imageResource->image();
-        }
-    }
-
-    return m_image;
+    // Compiled style sheets are shared between documents, so the image is
+    // not kept here; each document caches its own resources.
+    if(auto imageResource = document->fetchImageResource(m_value))
+        return imageResource->image();
+    return nullptr;
 }
 
 CssImageValue::CssImageValue(Url value)
@@ -538,6 +536,13 @@ CssRuleData::CssRuleData(const RefPtr<CssStyleRule>& rule, const CssSelector& se
     }
 }
 
+static void setAffectedByStructuralRules(const Element* element)
+{
+    if(auto parent = element->parentElement()) {
+        parent->setChildrenAffectedByStructuralRules();
+    }
+}
+
 bool CssRuleData::match(const Element* element, PseudoType pseudoType, const SelectorFilter& selectorFilter) const
 {
     for (auto hash : m_hashes) {
@@ -571,6 +576,7 @@ bool CssRuleData::matchSelector(const Element* element, PseudoType pseudoType, c
             break;
         case CssComplexSelector::Combinator::DirectAdjacent:
         case CssComplexSelector::Combinator::InDirectAdjacent:
+            setAffectedByStructuralRules(element);
             element = element->previousSiblingElement();
             break;
         case CssComplexSelector::Combinator::None:
@@ -650,6 +656,7 @@ bool CssRuleData::matchSimpleSelector(const Element* element, const CssSimpleSel
     case CssSimpleSelector::MatchType::PseudoClassNot:
         return matchPseudoClassNotSelector(element, selector);
     case CssSimpleSelector::MatchType::PseudoClassHas:
+        setAffectedByStructuralRules(element);
         return matchPseudoClassHasSelector(element, selector);
     case CssSimpleSelector::MatchType::PseudoClassLink:
     case CssSimpleSelector::MatchType::PseudoClassAnyLink:
@@ -668,26 +675,37 @@ bool CssRuleData::matchSimpleSelector(const Element* element, const CssSimpleSel
     case CssSimpleSelector::MatchType::PseudoClassScope:
         return matchPseudoClassRootSelector(element, selector);
     case CssSimpleSelector::MatchType::PseudoClassEmpty:
+        setAffectedByStructuralRules(element);
         return matchPseudoClassEmptySelector(element, selector);
     case CssSimpleSelector::MatchType::PseudoClassFirstChild:
+        setAffectedByStructuralRules(element);
         return matchPseudoClassFirstChildSelector(element, selector);
     case CssSimpleSelector::MatchType::PseudoClassLastChild:
+        setAffectedByStructuralRules(element);
         return matchPseudoClassLastChildSelector(element, selector);
     case CssSimpleSelector::MatchType::PseudoClassOnlyChild:
+        setAffectedByStructuralRules(element);
         return matchPseudoClassOnlyChildSelector(element, selector);
     case CssSimpleSelector::MatchType::PseudoClassFirstOfType:
+        setAffectedByStructuralRules(element);
         return matchPseudoClassFirstOfTypeSelector(element, selector);
     case CssSimpleSelector::MatchType::PseudoClassLastOfType:
+        setAffectedByStructuralRules(element);
         return matchPseudoClassLastOfTypeSelector(element, selector);
     case CssSimpleSelector::MatchType::PseudoClassOnlyOfType:
+        setAffectedByStructuralRules(element);
         return matchPseudoClassOnlyOfTypeSelector(element, selector);
     case CssSimpleSelector::MatchType::PseudoClassNthChild:
+        setAffectedByStructuralRules(element);
         return matchPseudoClassNthChildSelector(element, selector);
     case CssSimpleSelector::MatchType::PseudoClassNthLastChild:
+        setAffectedByStructuralRules(element);
         return matchPseudoClassNthLastChildSelector(element, selector);
     case CssSimpleSelector::MatchType::PseudoClassNthOfType:
+        setAffectedByStructuralRules(element);
         return matchPseudoClassNthOfTypeSelector(element, selector);
     case CssSimpleSelector::MatchType::PseudoClassNthLastOfType:
+        setAffectedByStructuralRules(element);
         return matchPseudoClassNthLastOfTypeSelector(element, selector);
     default:
         return false;
@@ -979,13 +979,11 @@ namespace plutobook {
         static ValPtr<CssImageValue> create(Url value);
 
         const Url& value() const { return m_value; }
-        const RefPtr<Image>& image() const { return m_image; }
-        const RefPtr<Image>& fetch(Document* document) const;
+        RefPtr<Image> fetch(Document* document) const;
 
     private:
         CssImageValue(Url value);
         Url m_value;
-        mutable RefPtr<Image> m_image;
     };
 
     class CssColorValue final : public CssSmallValue {
@@ -7,6 +7,7 @@
 #include "box-style.h"
 
 #include "plutobook.hpp"
+#include <mutex>
 #include <span>
 
 namespace plutobook {
@@ -434,22 +435,40 @@ public:
         , m_selectorFilter(selectorFilter)
     {}
 
-    void add(const CssRuleDataList& rules) {
+    void add(const CssRuleDataList& rules, uint32_t position) {
         for (const auto& rule : rules) {
             if (rule.match(m_element, m_pseudoType, m_selectorFilter)) {
-                merge(rule.specificity(), rule.position(), rule.properties());
+                m_matchedRules.emplace_back(&rule, position + rule.position());
             }
         }
     }
 
-    RefPtr<BoxStyle> build();
+    RefPtr<BoxStyle> build(MatchedPropertiesCache* cache = nullptr);
 
 private:
+    bool isCacheable() const;
+    RefPtr<BoxStyle> createStyle();
+
+    struct MatchedRule {
+        const CssRuleData* data;
+        uint32_t position;
+    };
+
     Element* m_element;
     const SelectorFilter& m_selectorFilter;
+    std::vector<MatchedRule> m_matchedRules;
 };
 
-RefPtr<BoxStyle> ElementStyleBuilder::build()
+bool ElementStyleBuilder::isCacheable() const
+{
+    // The root and body styles are looked up through their node, and the
+    // SVG ones resolve lengths against it.
+    return m_pseudoType == PseudoType::None && m_allProperties.empty()
+        && !m_element->isRootNode() && !m_element->isSvgElement()
+        && !m_element->isOfType(xhtmlNs, bodyTag);
+}
+
+RefPtr<BoxStyle> ElementStyleBuilder::build(MatchedPropertiesCache* cache)
 {
     if(m_pseudoType == PseudoType::None) {
         AttributeStyle attrStyle(m_element);
@@ -458,6 +477,33 @@ RefPtr<BoxStyle> ElementStyleBuilder::build()
         merge(0, 0, m_element->inlineStyle());
     }
 
+    // Only the matched rules are part of the key, so elements carrying
+    // presentational attributes or an inline style are not cached.
+    if(cache == nullptr || !isCacheable()) {
+        for(const auto& rule : m_matchedRules)
+            merge(rule.data->specificity(), rule.position, rule.data->properties());
+        return createStyle();
+    }
+
+    MatchedPropertiesCache::Key key;
+    key.rules.reserve(m_matchedRules.size());
+    for(const auto& rule : m_matchedRules)
+        key.rules.push_back(uint64_t(rule.position) << 32 | rule.data->specificity());
+    key.parentStyle = m_parentStyle;
+    if(auto style = cache->find(key)) {
+        return style;
+    }
+
+    for(const auto& rule : m_matchedRules)
+        merge(rule.data->specificity(), rule.position, rule.data->properties());
+    auto newStyle = createStyle();
+    if(newStyle && newStyle->position() != Position::Running)
+        cache->add(std::move(key), newStyle);
+    return newStyle;
+}
+
+RefPtr<BoxStyle> ElementStyleBuilder::createStyle()
+{
     if(m_allProperties.empty()) {
         if(m_pseudoType == PseudoType::None) {
             if(m_element->isRootNode() || m_parentStyle->isDisplayFlex())
@@ -521,7 +567,7 @@ class PageStyleBuilder final : public StyleBuilder {
 public:
     PageStyleBuilder(GlobalString pageName, uint32_t pageIndex, PageMarginType marginType, PseudoType pseudoType, const BoxStyle* parentStyle);
 
-    void add(const CssPageRuleDataList& rules);
+    void add(const CssPageRuleDataList& rules, uint32_t position);
     RefPtr<BoxStyle> build();
 
 private:
@@ -538,16 +584,16 @@ PageStyleBuilder::PageStyleBuilder(GlobalString pageName, uint32_t pageIndex, Pa
 {
 }
 
-void PageStyleBuilder::add(const CssPageRuleDataList& rules)
+void PageStyleBuilder::add(const CssPageRuleDataList& rules, uint32_t position)
 {
     for(const auto& rule : rules) {
         if(rule.match(m_pageName, m_pageIndex, m_pseudoType)) {
             if(m_marginType == PageMarginType::None) {
-                merge(rule.specificity(), rule.position(), rule.properties());
+                merge(rule.specificity(), position + rule.position(), rule.properties());
             } else {
                 for(const auto& margin : rule.margins()) {
                     if(m_marginType == margin->marginType()) {
-                        merge(rule.specificity(), rule.position(), margin->properties());
+                        merge(rule.specificity(), position + rule.position(), margin->properties());
                     }
                 }
             }
@@ -640,66 +686,237 @@ RefPtr<BoxStyle> PageStyleBuilder::build()
     return newStyle;
 }
 
-static const CssRuleList& userAgentRules()
+// Compiled rule sets, shared by every document of the process. Parsing a
+// sheet depends on the parser context and on the media environment the
+// media rules are evaluated against, so both are part of the key along
+// with the content.
+class CssRuleSetCache {
+public:
+    static CssRuleSetCache* instance();
+
+    RefPtr<CssRuleSet> get(const Document* document, const CssParserContext& context, std::string_view content);
+
+private:
+    CssRuleSetCache() = default;
+
+    static constexpr size_t kMaxEntryCount = 64;
+
+    struct Key {
+        std::string content;
+        Url baseUrl;
+        CssStyleOrigin origin;
+        bool inHtmlDocument;
+        bool inSvgElement;
+        bool hasContext;
+        MediaType mediaType;
+        float viewportWidth;
+        float viewportHeight;
+
+        bool operator==(const Key& other) const = default;
+
+        friend std::size_t hash_value(const Key& self) {
+            std::size_t seed = 0;
+            boost::hash_combine(seed, self.content);
+            boost::hash_combine(seed, self.baseUrl);
+            boost::hash_combine(seed, self.origin);
+            boost::hash_combine(seed, self.inHtmlDocument);
+            boost::hash_combine(seed, self.inSvgElement);
+            boost::hash_combine(seed, self.hasContext);
+            boost::hash_combine(seed, self.mediaType);
+            boost::hash_combine(seed, self.viewportWidth);
+            boost::hash_combine(seed, self.viewportHeight);
+            return seed;
+        }
+    };
+
+    std::mutex m_mutex;
+    boost::unordered_flat_map<Key, RefPtr<CssRuleSet>> m_entries;
+};
+
+CssRuleSetCache* CssRuleSetCache::instance()
 {
-    static CssRuleList rules = []() {
-        CssParserContext context(nullptr, CssStyleOrigin::UserAgent, ResourceLoader::baseUrl());
-        CssParser parser(context);
-        return parser.parseSheet(kUserAgentStyle);
-    }();
+    static CssRuleSetCache cache;
+    return &cache;
+}
+
+RefPtr<CssRuleSet> CssRuleSetCache::get(const Document* document, const CssParserContext& context, std::string_view content)
+{
+    auto documentContext = document->context();
+
+    Key key;
+    key.content = content;
+    key.baseUrl = context.baseUrl();
+    key.origin = context.origin();
+    key.inHtmlDocument = context.inHtmlDocument();
+    key.inSvgElement = context.inSvgElement();
+    key.hasContext = documentContext != nullptr;
+    key.mediaType = documentContext ? documentContext->mediaType() : MediaType::Print;
+    key.viewportWidth = documentContext ? documentContext->viewportWidth() : 0.f;
+    key.viewportHeight = documentContext ? documentContext->viewportHeight() : 0.f;
+
+    std::unique_lock lock(m_mutex);
+    auto it = m_entries.find(key);
+    if(it != m_entries.end())
+        return it->second;
+    lock.unlock();
+
+    // The sheet is compiled without holding the lock; if another thread
+    // compiled it in the meantime, its rule set is kept.
+    CssParser parser(context);
+    auto ruleSet = CssRuleSet::create(document, parser.parseSheet(content));
 
-    return rules;
+    lock.lock();
+    if(m_entries.size() >= kMaxEntryCount)
+        m_entries.clear();
+    return m_entries.try_emplace(std::move(key), ruleSet).first->second;
 }
 
 CssStyleSheet::CssStyleSheet(Document* document)
     : m_document(document)
 {
     if(document->context()) {
-        addRuleList(userAgentRules());
+        CssParserContext context(nullptr, CssStyleOrigin::UserAgent, ResourceLoader::baseUrl());
+        addRuleSet(CssRuleSetCache::instance()->get(document, context, kUserAgentStyle));
+    }
+}
+
+static bool canShareStyle(const Element* element, const Element* candidate)
+{
+    return element != candidate
+        && element->isOfType(candidate->namespaceURI(), candidate->tagName())
+        && element->hover() == candidate->hover()
+        && element->active() == candidate->active()
+        && element->focus() == candidate->focus()
+        && element->attributes() == candidate->attributes();
+}
+
+StyleSharingCache::Entry* StyleSharingCache::findEntry(const Element* parent, const BoxStyle* parentStyle)
+{
+    for(auto& entry : m_entries) {
+        if(entry.parent == parent && entry.parentStyle == parentStyle) {
+            return &entry;
+        }
     }
+
+    return nullptr;
+}
+
+RefPtr<BoxStyle> StyleSharingCache::find(const Element* element, const BoxStyle* parentStyle)
+{
+    auto parent = element->parentElement();
+    if(parent == nullptr || parent->childrenAffectedByStructuralRules())
+        return nullptr;
+    if(auto entry = findEntry(parent, parentStyle)) {
+        for(const auto& candidate : entry->candidates) {
+            if(canShareStyle(element, candidate.element)) {
+                return candidate.style;
+            }
+        }
+    }
+
+    return nullptr;
+}
+
+void StyleSharingCache::add(const Element* element, const BoxStyle* parentStyle, const RefPtr<BoxStyle>& style)
+{
+    // Running elements are looked up again through the node of their style,
+    // which a shared style would not point to.
+    auto parent = element->parentElement();
+    if(parent == nullptr || style == nullptr || style->position() == Position::Running)
+        return;
+    auto entry = findEntry(parent, parentStyle);
+    if(entry == nullptr) {
+        if(m_entries.size() == kMaxParentCount)
+            m_entries.erase(m_entries.begin());
+        entry = &m_entries.emplace_back(parent, parentStyle);
+    }
+
+    auto& candidates = entry->candidates;
+    if(candidates.size() == kMaxCandidateCount)
+        candidates.erase(candidates.begin());
+    candidates.emplace_back(element, style);
+}
+
+RefPtr<BoxStyle> MatchedPropertiesCache::find(const Key& key)
+{
+    auto it = m_entries.find(key);
+    if(it == m_entries.end()) {
+        ++m_missCount;
+        return nullptr;
+    }
+
+    ++m_hitCount;
+    return it->second.style;
+}
+
+void MatchedPropertiesCache::add(Key&& key, const RefPtr<BoxStyle>& style)
+{
+    if(m_entries.size() >= kMaxEntryCount)
+        m_entries.clear();
+    RefPtr<BoxStyle> parentStyle(const_cast<BoxStyle*>(key.parentStyle));
+    m_entries.emplace(std::move(key), Entry{std::move(parentStyle), style});
 }
 
 RefPtr<BoxStyle> CssStyleSheet::styleForElement(Element* element, const SelectorFilter& selectorFilter, const BoxStyle* parentStyle) const
 {
+    if(auto style = m_styleSharingCache.find(element, parentStyle))
+        return style;
     ElementStyleBuilder builder(element, PseudoType::None, selectorFilter, parentStyle);
-    for (const auto& className : element->classNames()) {
-        if (const auto rules = m_classRules.get(className))
-            builder.add(*rules);
-    }
-    for (const auto& attribute : element->attributes()) {
-        if (const auto rules = m_attributeRules.get(element->foldCase(attribute.name())))
-            builder.add(*rules);
+    for (const auto& layer : m_layers) {
+        const auto& ruleSet = *layer.ruleSet;
+        for (const auto& className : element->classNames()) {
+            if (const auto rules = ruleSet.classRules().get(className))
+                builder.add(*rules, layer.position);
+        }
+        for (const auto& attribute : element->attributes()) {
+            if (const auto rules = ruleSet.attributeRules().get(element->foldCase(attribute.name())))
+                builder.add(*rules, layer.position);
+        }
+        if (const auto rules = ruleSet.tagRules().get(element->foldTagNameCase()))
+            builder.add(*rules, layer.position);
+        if (const auto rules = ruleSet.idRules().get(element->id()))
+            builder.add(*rules, layer.position);
+        builder.add(ruleSet.universalRules(), layer.position);
     }
-    if (const auto rules = m_tagRules.get(element->foldTagNameCase()))
-        builder.add(*rules);
-    if (const auto rules = m_idRules.get(element->id()))
-        builder.add(*rules);
-    builder.add(m_universalRules);
-    return builder.build();
+
+    auto newStyle = builder.build(&m_matchedPropertiesCache);
+    m_styleSharingCache.add(element, parentStyle, newStyle);
+    return newStyle;
 }
 
 RefPtr<BoxStyle> CssStyleSheet::pseudoStyleForElement(Element* element, PseudoType pseudoType, const SelectorFilter& selectorFilter, const BoxStyle* parentStyle) const
 {
     ElementStyleBuilder builder(element, pseudoType, selectorFilter, parentStyle);
-    if (const auto rules = m_pseudoRules.get(pseudoType))
-        builder.add(*rules);
+    for (const auto& layer : m_layers) {
+        if (const auto rules = layer.ruleSet->pseudoRules().get(pseudoType)) {
+            builder.add(*rules, layer.position);
+        }
+    }
+
     return builder.build();
 }
 
 RefPtr<BoxStyle> CssStyleSheet::styleForPage(GlobalString pageName, uint32_t pageIndex, PseudoType pseudoType) const
 {
     PageStyleBuilder builder(pageName, pageIndex, PageMarginType::None, pseudoType, m_document->rootStyle());
-    builder.add(m_pageRules);
+    for(const auto& layer : m_layers)
+        builder.add(layer.ruleSet->pageRules(), layer.position);
     return builder.build();
 }
 
 RefPtr<BoxStyle> CssStyleSheet::styleForPageMargin(GlobalString pageName, uint32_t pageIndex, PageMarginType marginType, const BoxStyle* pageStyle) const
 {
     PageStyleBuilder builder(pageName, pageIndex, marginType, pageStyle->pseudoType(), pageStyle);
-    builder.add(m_pageRules);
+    for(const auto& layer : m_layers)
+        builder.add(layer.ruleSet->pageRules(), layer.position);
     return builder.build();
 }
 
+bool CssStyleSheet::hasFontFace(GlobalString family) const
+{
+    return m_fontFaces.contains(family);
+}
+
 RefPtr<FontData> CssStyleSheet::getFontData(GlobalString family, const FontDataDescription& description) const
 {
     auto it = m_fontFaces.find(family);
@@ -751,11 +968,49 @@ std::string CssStyleSheet::getMarkerText(int value, GlobalString listType)
 void CssStyleSheet::parseStyle(std::string_view content, CssStyleOrigin origin, Url baseUrl)
 {
     CssParserContext context(m_document, origin, std::move(baseUrl));
-    CssParser parser(context);
-    addRuleList(parser.parseSheet(content));
+    addRuleSet(CssRuleSetCache::instance()->get(m_document, context, content));
 }
 
-void CssStyleSheet::addRuleList(const CssRuleList& rules)
+void CssStyleSheet::addRuleSet(const RefPtr<CssRuleSet>& ruleSet)
+{
+    // Import rules come before any other rule of a sheet, so the imported
+    // sheets are added first to keep their rules ahead in the cascade.
+    const auto& importRules = ruleSet->importRules();
+    if(importRules.size() > 1 && m_importDepth < kMaxImportDepth) {
+        std::vector<Document::PreloadRequest> requests;
+        for(const auto& rule : importRules) {
+            if(m_document->supportsMediaQueries(rule->queries())) {
+                requests.emplace_back(rule->href(), Resource::Type::Text);
+            }
+        }
+
+        m_document->preloadResources(requests);
+    }
+
+    for(const auto& rule : importRules)
+        addImportRule(rule);
+    m_layers.emplace_back(ruleSet, m_position);
+    m_position += ruleSet->positionCount();
+    if(ruleSet->hasRelativeStateRules())
+        m_hasRelativeStateRules = true;
+    for(const auto& rule : ruleSet->fontFaceRules()) {
+        addFontFaceRule(rule);
+    }
+
+    if(!ruleSet->counterStyleRules().empty()) {
+        assert(m_counterStyleMap == nullptr);
+        m_counterStyleRules.insert(m_counterStyleRules.end(), ruleSet->counterStyleRules().begin(), ruleSet->counterStyleRules().end());
+    }
+}
+
+RefPtr<CssRuleSet> CssRuleSet::create(const Document* document, const CssRuleList& rules)
+{
+    auto ruleSet = adoptPtr(new CssRuleSet);
+    ruleSet->addRuleList(document, rules);
+    return ruleSet;
+}
+
+void CssRuleSet::addRuleList(const Document* document, const CssRuleList& rules)
 {
     for(const auto& rule : rules) {
         switch(rule->type()) {
@@ -763,19 +1018,19 @@ void CssStyleSheet::addRuleList(const CssRuleList& rules)
             addStyleRule(to<CssStyleRule>(rule));
             break;
         case CssRuleType::Import:
-            addImportRule(to<CssImportRule>(rule));
+            m_importRules.push_back(to<CssImportRule>(rule));
             break;
         case CssRuleType::Page:
             addPageRule(to<CssPageRule>(rule));
             break;
         case CssRuleType::FontFace:
-            addFontFaceRule(to<CssFontFaceRule>(rule));
+            m_fontFaceRules.push_back(to<CssFontFaceRule>(rule));
             break;
         case CssRuleType::CounterStyle:
-            addCounterStyleRule(to<CssCounterStyleRule>(rule));
+            m_counterStyleRules.push_back(rule);
             break;
         case CssRuleType::Media:
-            addMediaRule(to<CssMediaRule>(rule));
+            addMediaRule(document, to<CssMediaRule>(rule));
             break;
         default:
             break;
@@ -785,7 +1040,41 @@ void CssStyleSheet::addRuleList(const CssRuleList& rules)
     }
 }
 
-void CssStyleSheet::addStyleRule(const RefPtr<CssStyleRule>& rule)
+// Returns true if the selector can match differently when the hover, active
+// or focus state of an element other than its subject changes.
+static bool dependsOnRelativeState(const CssSelector& selector, bool isSubject)
+{
+    for(const auto& complexSelector : selector) {
+        for(const auto& simpleSelector : complexSelector.compoundSelector()) {
+            switch(simpleSelector.matchType()) {
+            case CssSimpleSelector::MatchType::PseudoClassHas:
+            case CssSimpleSelector::MatchType::PseudoClassFocusWithin:
+                return true;
+            case CssSimpleSelector::MatchType::PseudoClassActive:
+            case CssSimpleSelector::MatchType::PseudoClassFocus:
+            case CssSimpleSelector::MatchType::PseudoClassFocusVisible:
+            case CssSimpleSelector::MatchType::PseudoClassHover:
+                if(!isSubject)
+                    return true;
+                break;
+            default:
+                break;
+            }
+
+            for(const auto& subSelector : simpleSelector.subSelectors()) {
+                if(dependsOnRelativeState(subSelector, isSubject)) {
+                    return true;
+                }
+            }
+        }
+
+        isSubject = false;
+    }
+
+    return false;
+}
+
+void CssRuleSet::addStyleRule(const RefPtr<CssStyleRule>& rule)
 {
     for(const auto& selector : rule->selectors()) {
         uint32_t specificity = 0;
@@ -833,6 +1122,8 @@ void CssStyleSheet::addStyleRule(const RefPtr<CssStyleRule>& rule)
             }
         }
 
+        if(!m_hasRelativeStateRules)
+            m_hasRelativeStateRules = dependsOnRelativeState(selector, pseudoType == PseudoType::None);
         CssRuleData ruleData(rule, selector, specificity, m_position);
         if(pseudoType != PseudoType::None) {
             m_pseudoRules.add(pseudoType, std::move(ruleData));
@@ -852,7 +1143,6 @@ void CssStyleSheet::addStyleRule(const RefPtr<CssStyleRule>& rule)
 
 void CssStyleSheet::addImportRule(const RefPtr<CssImportRule>& rule)
 {
-    constexpr auto kMaxImportDepth = 256;
     if(m_importDepth < kMaxImportDepth && m_document->supportsMediaQueries(rule->queries())) {
         if(auto resource = m_document->fetchTextResource(rule->href())) {
             m_importDepth++;
@@ -862,7 +1152,7 @@ void CssStyleSheet::addImportRule(const RefPtr<CssImportRule>& rule)
     }
 }
 
-void CssStyleSheet::addPageRule(const RefPtr<CssPageRule>& rule)
+void CssRuleSet::addPageRule(const RefPtr<CssPageRule>& rule)
 {
     const auto& selectors = rule->selectors();
     if(selectors.empty()) {
@@ -1129,16 +1419,10 @@ void CssStyleSheet::addFontFaceRule(const RefPtr<CssFontFaceRule>& rule)
     }
 }
 
-void CssStyleSheet::addCounterStyleRule(const RefPtr<CssCounterStyleRule>& rule)
-{
-    assert(m_counterStyleMap == nullptr);
-    m_counterStyleRules.push_back(rule);
-}
-
-void CssStyleSheet::addMediaRule(const RefPtr<CssMediaRule>& rule)
+void CssRuleSet::addMediaRule(const Document* document, const RefPtr<CssMediaRule>& rule)
 {
-    if(m_document->supportsMediaQueries(rule->queries())) {
-        addRuleList(rule->rules());
+    if(document->supportsMediaQueries(rule->queries())) {
+        addRuleList(document, rule->rules());
     }
 }
 
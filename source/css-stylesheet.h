@@ -76,6 +76,152 @@ namespace plutobook {
 
     class SelectorFilter;
 
+    // Remembers the styles last computed for the children of a few parents,
+    // so that a sibling with the same tag, attributes and state can reuse a
+    // style instead of running the cascade again.
+    class StyleSharingCache {
+    public:
+        StyleSharingCache() = default;
+
+        RefPtr<BoxStyle> find(const Element* element,
+                              const BoxStyle* parentStyle);
+        void add(const Element* element, const BoxStyle* parentStyle,
+                 const RefPtr<BoxStyle>& style);
+        void clear() { m_entries.clear(); }
+
+    private:
+        static constexpr size_t kMaxParentCount = 16;
+        static constexpr size_t kMaxCandidateCount = 4;
+
+        struct Candidate {
+            const Element* element;
+            RefPtr<BoxStyle> style;
+        };
+
+        struct Entry {
+            const Element* parent;
+            const BoxStyle* parentStyle;
+            std::vector<Candidate> candidates;
+        };
+
+        Entry* findEntry(const Element* parent, const BoxStyle* parentStyle);
+
+        std::vector<Entry> m_entries;
+    };
+
+    // Maps the list of rules an element matched, together with its parent
+    // style, to the style the cascade computed from them, so that elements
+    // matching the same rules under the same parent style skip the cascade.
+    class MatchedPropertiesCache {
+    public:
+        struct Key {
+            std::vector<uint64_t> rules;
+            const BoxStyle* parentStyle{nullptr};
+
+            bool operator==(const Key& other) const = default;
+
+            friend std::size_t hash_value(const Key& self) {
+                std::size_t seed = 0;
+                boost::hash_range(seed, self.rules.begin(), self.rules.end());
+                boost::hash_combine(seed, self.parentStyle);
+                return seed;
+            }
+        };
+
+        MatchedPropertiesCache() = default;
+
+        RefPtr<BoxStyle> find(const Key& key);
+        void add(Key&& key, const RefPtr<BoxStyle>& style);
+        void clear() { m_entries.clear(); }
+
+        uint32_t hitCount() const { return m_hitCount; }
+        uint32_t missCount() const { return m_missCount; }
+
+    private:
+        static constexpr size_t kMaxEntryCount = 1024;
+
+        struct Entry {
+            // Keeps the parent style alive so that its address, which is
+            // part of the key, cannot be reused by another style.
+            RefPtr<BoxStyle> parentStyle;
+            RefPtr<BoxStyle> style;
+        };
+
+        boost::unordered_flat_map<Key, Entry> m_entries;
+        uint32_t m_hitCount{0};
+        uint32_t m_missCount{0};
+    };
+
+    // The rules of one style sheet, indexed for matching. A rule set is
+    // immutable once compiled, so documents that add the same sheet in the
+    // same media environment share one instead of parsing and indexing the
+    // sheet again. The rules inside media rules that do not apply are left
+    // out; import and font face rules need the document that uses them and
+    // are replayed by each style sheet the rule set is added to.
+    class CssRuleSet : public RefCounted<CssRuleSet> {
+    public:
+        static RefPtr<CssRuleSet> create(const Document* document,
+                                         const CssRuleList& rules);
+
+        const CssRuleDataMap<HeapString>& idRules() const { return m_idRules; }
+        const CssRuleDataMap<HeapString>& classRules() const {
+            return m_classRules;
+        }
+        const CssRuleDataMap<GlobalString>& tagRules() const {
+            return m_tagRules;
+        }
+        const CssRuleDataMap<GlobalString>& attributeRules() const {
+            return m_attributeRules;
+        }
+        const CssRuleDataMap<PseudoType>& pseudoRules() const {
+            return m_pseudoRules;
+        }
+
+        const CssRuleDataList& universalRules() const {
+            return m_universalRules;
+        }
+        const CssPageRuleDataList& pageRules() const { return m_pageRules; }
+
+        const std::vector<RefPtr<CssImportRule>>& importRules() const {
+            return m_importRules;
+        }
+        const std::vector<RefPtr<CssFontFaceRule>>& fontFaceRules() const {
+            return m_fontFaceRules;
+        }
+        const CssRuleList& counterStyleRules() const {
+            return m_counterStyleRules;
+        }
+
+        // The positions of the rules are relative to the start of the set;
+        // this is the number of positions the set takes up.
+        uint32_t positionCount() const { return m_position; }
+
+        bool hasRelativeStateRules() const { return m_hasRelativeStateRules; }
+
+    private:
+        CssRuleSet() = default;
+        void addRuleList(const Document* document, const CssRuleList& rules);
+        void addStyleRule(const RefPtr<CssStyleRule>& rule);
+        void addPageRule(const RefPtr<CssPageRule>& rule);
+        void addMediaRule(const Document* document,
+                          const RefPtr<CssMediaRule>& rule);
+
+        uint32_t m_position{0};
+        bool m_hasRelativeStateRules{false};
+
+        CssRuleDataMap<HeapString> m_idRules;
+        CssRuleDataMap<HeapString> m_classRules;
+        CssRuleDataMap<GlobalString> m_tagRules;
+        CssRuleDataMap<GlobalString> m_attributeRules;
+        CssRuleDataMap<PseudoType> m_pseudoRules;
+
+        CssRuleDataList m_universalRules;
+        CssPageRuleDataList m_pageRules;
+        std::vector<RefPtr<CssImportRule>> m_importRules;
+        std::vector<RefPtr<CssFontFaceRule>> m_fontFaceRules;
+        CssRuleList m_counterStyleRules;
+    };
+
     class CssStyleSheet {
     public:
         explicit CssStyleSheet(Document* document);
@@ -98,6 +244,7 @@ namespace plutobook {
         RefPtr<FontData>
         getFontData(GlobalString family,
                     const FontDataDescription& description) const;
+        bool hasFontFace(GlobalString family) const;
 
         const CssCounterStyle& getCounterStyle(GlobalString name);
         std::string getCounterText(int value, GlobalString listType);
@@ -106,29 +253,47 @@ namespace plutobook {
         void parseStyle(std::string_view content, CssStyleOrigin origin,
                         Url baseUrl);
 
+        // Drops the styles kept for reuse; called once a pass over the tree
+        // is done so that they do not outlive their boxes.
+        void clearStyleCaches() const {
+            m_styleSharingCache.clear();
+            m_matchedPropertiesCache.clear();
+        }
+
+        const MatchedPropertiesCache& matchedPropertiesCache() const {
+            return m_matchedPropertiesCache;
+        }
+
+        // True if some rule matches on the hover, active or focus state of
+        // an ancestor, a sibling or a descendant of its subject, or has a
+        // pseudo-element subject. Such state changes cannot be restyled
+        // element by element.
+        bool hasRelativeStateRules() const { return m_hasRelativeStateRules; }
+
     private:
-        void addRuleList(const CssRuleList& rules);
-        void addStyleRule(const RefPtr<CssStyleRule>& rule);
+        void addRuleSet(const RefPtr<CssRuleSet>& ruleSet);
         void addImportRule(const RefPtr<CssImportRule>& rule);
-        void addPageRule(const RefPtr<CssPageRule>& rule);
         void addFontFaceRule(const RefPtr<CssFontFaceRule>& rule);
-        void addCounterStyleRule(const RefPtr<CssCounterStyleRule>& rule);
-        void addMediaRule(const RefPtr<CssMediaRule>& rule);
+
+        // A rule set added to the style sheet, with the position its rules
+        // start at among the rules of the document.
+        struct Layer {
+            RefPtr<CssRuleSet> ruleSet;
+            uint32_t position;
+        };
+
+        static constexpr uint32_t kMaxImportDepth = 256;
 
         Document* m_document;
         uint32_t m_position{0};
         uint32_t m_importDepth{0};
+        bool m_hasRelativeStateRules{false};
 
-        CssRuleDataMap<HeapString> m_idRules;
-        CssRuleDataMap<HeapString> m_classRules;
-        CssRuleDataMap<GlobalString> m_tagRules;
-        CssRuleDataMap<GlobalString> m_attributeRules;
-        CssRuleDataMap<PseudoType> m_pseudoRules;
-
-        CssRuleDataList m_universalRules;
-        CssPageRuleDataList m_pageRules;
+        std::vector<Layer> m_layers;
         CssRuleList m_counterStyleRules;
         CssFontFaceMap m_fontFaces;
         std::unique_ptr<CssCounterStyleMap> m_counterStyleMap;
+        mutable StyleSharingCache m_styleSharingCache;
+        mutable MatchedPropertiesCache m_matchedPropertiesCache;
     };
 } // namespace plutobook
\ No newline at end of file
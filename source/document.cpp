@@ -66,16 +66,19 @@ void Node::reparent(ContainerNode* newParent)
 void Node::setDirtyStyle()
 {
     m_dirtyStyle = true;
-    m_document->m_dirtyContent = true;
-#if 0
     auto parent = m_parentNode;
     while (parent) {
-        if (parent->m_dirtyContent)
-            break;
-        parent->m_dirtyContent = true;
+        parent->m_dirtyChildStyle = true;
         parent = parent->parentNode();
     }
-#endif // 0
+}
+
+void Node::setSubtreeDirtyStyle()
+{
+    m_dirtyStyle = true;
+    for (auto child = firstChild(); child; child = child->nextSibling()) {
+        child->setSubtreeDirtyStyle();
+    }
 }
 
 void Node::remove()
@@ -325,6 +328,23 @@ void ContainerNode::buildChildrenBox(Counters& counters, SelectorFilter& selecto
     }
 }
 
+bool ContainerNode::updateChildrenStyle(SelectorFilter& selectorFilter)
+{
+    m_dirtyChildStyle = false;
+    auto child = m_firstChild;
+    while(child) {
+        if(auto element = to<Element>(child)) {
+            if(!element->updateStyle(selectorFilter)) {
+                return false;
+            }
+        }
+
+        child = child->nextSibling();
+    }
+
+    return true;
+}
+
 void ContainerNode::finishParsingDocument()
 {
     auto child = m_firstChild;
@@ -463,17 +483,19 @@ void Element::parseAttribute(GlobalString name, const HeapString& value)
             }
             begin = end + 1;
         }
+    } else if(name == styleAttr) {
+        m_inlineStyle = nullptr;
     }
 }
 
-CssPropertyList Element::inlineStyle() const
+const CssPropertyList& Element::inlineStyle() const
 {
-    const auto& value = getAttribute(styleAttr);
-    if(value.empty())
-        return CssPropertyList();
-    CssParserContext context(this, CssStyleOrigin::Inline, document()->baseUrl());
-    CssParser parser(context);
-    return parser.parseStyle(value);
+    // Parsed on first use rather than in parseAttribute() since the base
+    // url, which relative urls in the declarations resolve against, is
+    // only known once the whole document has been parsed.
+    if(m_inlineStyle == nullptr)
+        m_inlineStyle = &document()->parseInlineStyle(this, getAttribute(styleAttr));
+    return *m_inlineStyle;
 }
 
 Element* Element::parentElement() const
@@ -552,8 +574,10 @@ void Element::buildElementChildrenBox(Counters& counters, SelectorFilter& select
 void Element::buildBox(Counters& counters, SelectorFilter& selectorFilter, Box* parent)
 {
     RefPtr<BoxStyle> style(Node::style());
+    m_dirtyChildStyle = false;
     if (m_dirtyStyle) {
         m_dirtyStyle = false;
+        document()->incrementRestyledBoxCount();
         auto newStyle = document()->styleSheet().styleForElement(
             this, selectorFilter, parent->style());
         if (!isSame(style, newStyle)) {
@@ -574,6 +598,157 @@ void Element::buildBox(Counters& counters, SelectorFilter& selectorFilter, Box*
     //}
 }
 
+static bool canRestyleInPlace(const Element* element, const Box* box)
+{
+    // SVG boxes resolve their paint servers and collapsed table borders
+    // resolve their colors during layout, and the view copies the root and
+    // body backgrounds while building.
+    if(element->isSvgElement() || box->isRootBox() || box->isBodyBox())
+        return false;
+    if(box->style()->borderCollapse() == BorderCollapse::Collapse
+        && (box->isTableBox() || box->isTableSectionBox() || box->isTableRowBox()
+            || box->isTableColumnBox() || box->isTableCellBox())) {
+        return false;
+    }
+
+    // Anonymous and generated children derive their own style from this one.
+    for(auto child = box->firstChild(); child; child = child->nextSibling()) {
+        if(child->node() == nullptr) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Layers are linked into their enclosing layer, and list items, generated
+// content and counter properties depend on the counters of the boxes that
+// come before them, so boxes using any of them are only built with the
+// whole tree. Multi-column boxes only get their layer when built.
+static bool canRebuildSubtree(const Box* box)
+{
+    if(auto boxModel = to<BoxModel>(box); boxModel && boxModel->requiresLayer())
+        return false;
+    if(box->style()->hasColumns())
+        return false;
+    if(box->isListItemBox() || box->style()->pseudoType() != PseudoType::None)
+        return false;
+    for(auto id : { CssPropertyID::CounterReset, CssPropertyID::CounterIncrement, CssPropertyID::CounterSet }) {
+        if(box->style()->get(id)) {
+            return false;
+        }
+    }
+
+    for(auto child = box->firstChild(); child; child = child->nextSibling()) {
+        if(!canRebuildSubtree(child)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Element::rebuildBox(SelectorFilter& selectorFilter, const RefPtr<BoxStyle>& newStyle)
+{
+    // The new box must take the place of the old one without changing how
+    // its parent wraps its children, so both have to be in-flow blocks
+    // placed directly in the box of the parent element.
+    auto oldBox = m_box;
+    auto parentBox = oldBox->parentBox();
+    if(isSvgElement() || oldBox->isRootBox() || oldBox->isBodyBox()
+        || parentBox == nullptr || parentBox != parentNode()->box()
+        || !parentBox->isBlockFlowBox() || parentBox->isChildrenInline()
+        || oldBox->isInline() || oldBox->isFloatingOrPositioned()) {
+        return false;
+    }
+
+    auto oldStyle = oldBox->style();
+    if(newStyle->display() != oldStyle->display()
+        || newStyle->floating() != oldStyle->floating()
+        || newStyle->position() != oldStyle->position()
+        || !canRebuildSubtree(oldBox)) {
+        return false;
+    }
+
+    auto nextBox = oldBox->nextSibling();
+    oldBox->setStyle(newStyle);
+    m_dirtyStyle = false;
+    for(auto child = firstChild(); child; child = child->nextSibling())
+        child->setSubtreeDirtyStyle();
+    Counters counters(document(), 0);
+    buildBox(counters, selectorFilter, parentBox);
+
+    // The boxes are built but not linked into any layer yet, so the whole
+    // tree can still be rebuilt from here.
+    auto newBox = m_box;
+    if(newBox == nullptr || newBox->parentBox() != parentBox || !canRebuildSubtree(newBox))
+        return false;
+    if(newBox->nextSibling() != nextBox) {
+        parentBox->removeChild(newBox);
+        parentBox->insertChild(newBox, nextBox);
+    }
+
+    newBox->build();
+    document()->addRelayoutBox(parentBox);
+    return true;
+}
+
+bool Element::updateStyle(SelectorFilter& selectorFilter)
+{
+    if(!m_dirtyStyle && !m_dirtyChildStyle)
+        return true;
+    if(m_box == nullptr) {
+        // Nothing below an element without a box is rendered; only a change
+        // of its own style can give it one.
+        m_dirtyChildStyle = false;
+        return !m_dirtyStyle;
+    }
+
+    if(m_dirtyStyle) {
+        auto oldStyle = m_box->style();
+        auto newStyle = document()->styleSheet().styleForElement(this, selectorFilter, parentNode()->style());
+        document()->incrementRestyledBoxCount();
+        auto difference = compareStyles(oldStyle, newStyle.get());
+        if(difference == StyleDifference::Layout || (difference != StyleDifference::None && !canRestyleInPlace(this, m_box))) {
+            if(!rebuildBox(selectorFilter, newStyle)) {
+                setSubtreeDirtyStyle();
+                return false;
+            }
+
+            return true;
+        }
+
+        if(difference != StyleDifference::None) {
+            for(auto child = m_box->firstChild(); child; child = child->nextSibling()) {
+                if(child->style() == oldStyle) {
+                    child->setStyle(newStyle);
+                }
+            }
+
+            m_box->setStyle(newStyle);
+        }
+
+        m_dirtyStyle = false;
+        if(difference == StyleDifference::InheritedPaint) {
+            for(auto child = firstChild(); child; child = child->nextSibling()) {
+                if(auto element = to<Element>(child)) {
+                    element->m_dirtyStyle = true;
+                    m_dirtyChildStyle = true;
+                }
+            }
+        }
+    }
+
+    if(!m_dirtyChildStyle)
+        return true;
+    if(m_hasElementChildren)
+        selectorFilter.push(this);
+    auto result = updateChildrenStyle(selectorFilter);
+    if(m_hasElementChildren)
+        selectorFilter.pop();
+    return result;
+}
+
 void Element::finishParsingDocument()
 {
     if(m_tagName == aTag && (m_namespaceURI == xhtmlNs || m_namespaceURI == svgNs)) {
@@ -607,7 +782,6 @@ Document::Document(ClassKind type, Context* context, ResourceFetcher* fetcher, U
     , m_customResourceFetcher(fetcher)
     , m_baseUrl(std::move(baseUrl))
     , m_styleSheet(this)
-    , m_fontDataCache(new FontDataCache)
 {
 }
 
@@ -972,6 +1146,27 @@ bool Document::supportsMedia(std::string_view type, std::string_view media) cons
     return false;
 }
 
+FontDataCache* Document::fontDataCache() const
+{
+    return FontDataCache::instance();
+}
+
+const CssPropertyList& Document::parseInlineStyle(const Element* element, const HeapString& value)
+{
+    static const CssPropertyList emptyStyle;
+    if(value.empty())
+        return emptyStyle;
+    auto& inlineStyles = element->isSvgElement() ? m_svgInlineStyles : m_inlineStyles;
+    auto it = inlineStyles.find(value);
+    if(it == inlineStyles.end()) {
+        CssParserContext context(element, CssStyleOrigin::Inline, m_baseUrl);
+        CssParser parser(context);
+        it = inlineStyles.emplace(value, parser.parseStyle(value)).first;
+    }
+
+    return it->second;
+}
+
 RefPtr<Font> Document::createFont(const FontDescription& description)
 {
     auto& font = m_fontCache[description];
@@ -995,6 +1190,77 @@ RefPtr<FontResource> Document::fetchFontResource(const Url& url)
     return fetchResource<FontResource>(url);
 }
 
+void Document::preloadResources(const std::vector<PreloadRequest>& requests)
+{
+    // Custom fetchers are not required to be thread-safe, and local files
+    // and data urls are read faster than threads can be started.
+    if(m_customResourceFetcher)
+        return;
+    std::vector<Url> urls;
+    std::vector<Resource::Type> types;
+    for(const auto& request : requests) {
+        const auto& url = request.url;
+        if(!url.protocolIs("http") && !url.protocolIs("https"))
+            continue;
+        if(m_resourceCache.contains(url) || std::ranges::find(urls, url) != urls.end())
+            continue;
+        if(auto resource = ResourceCache::instance()->find(url, request.type, nullptr)) {
+            m_resourceCache.emplace(url, std::move(resource));
+            continue;
+        }
+
+        urls.push_back(url);
+        types.push_back(request.type);
+    }
+
+    if(urls.size() < 2)
+        return;
+    std::vector<std::string> errorMessages;
+    auto resources = ResourceLoader::loadUrls(urls, errorMessages);
+    for(size_t index = 0; index < urls.size(); ++index) {
+        // Failures are cached too, so that a dead host is not waited on
+        // again; the error is kept to be reported when the resource is
+        // fetched for its use.
+        auto resource = resources[index].isNull() ? nullptr : createResource(urls[index], types[index], resources[index]);
+        if(resource == nullptr) {
+            if(errorMessages[index].empty())
+                errorMessages[index] = plutobook_get_error_message();
+            m_preloadErrors.emplace(urls[index], std::move(errorMessages[index]));
+        }
+
+        m_resourceCache.emplace(urls[index], std::move(resource));
+    }
+}
+
+RefPtr<Resource> Document::loadResource(const Url& url, Resource::Type type)
+{
+    if(auto resource = ResourceCache::instance()->find(url, type, m_customResourceFetcher))
+        return resource;
+    return createResource(url, type, ResourceLoader::loadUrl(url, m_customResourceFetcher));
+}
+
+RefPtr<Resource> Document::createResource(const Url& url, Resource::Type type, const ResourceData& data)
+{
+    auto cache = ResourceCache::instance();
+    auto resource = cache->findContent(data, type);
+    if(resource == nullptr) {
+        switch(type) {
+        case Resource::Type::Text:
+            resource = TextResource::create(this, url, data);
+            break;
+        case Resource::Type::Image:
+            resource = ImageResource::create(this, url, data);
+            break;
+        case Resource::Type::Font:
+            resource = FontResource::create(this, url, data);
+            break;
+        }
+    }
+
+    cache->add(url, type, m_customResourceFetcher, data, resource);
+    return resource;
+}
+
 Node* Document::cloneNode(bool deep)
 {
     return nullptr;
@@ -1036,6 +1302,7 @@ void Document::buildBox(Counters& counters, SelectorFilter& selectorFilter, Box*
     if (m_dirtyContent) {
         m_dirtyLayout = true;
         m_dirtyContent = false;
+        m_dirtyChildStyle = false;
         auto rootBox = createBox(rootStyle);
         counters.push();
         buildChildrenBox(counters, selectorFilter, rootBox);
@@ -1049,6 +1316,7 @@ void Document::build()
     Counters counters(this, 0);
     SelectorFilter selectorFilter;
     buildBox(counters, selectorFilter, nullptr);
+    m_styleSheet.clearStyleCaches();
 }
 
 void Document::layout()
@@ -1059,36 +1327,155 @@ void Document::layout()
     }
 }
 
-void Document::paginate()
+static uint32_t countBoxes(const Box* box)
 {
-    PageLayout(this).layout();
+    uint32_t count = 1;
+    for(auto child = box->firstChild(); child; child = child->nextSibling())
+        count += countBoxes(child);
+    return count;
 }
 
-void Document::render(GraphicsContext& context, const Rect& rect)
+bool Document::update()
 {
-    box()->paintLayer(context, rect);
+    m_restyledBoxCount = 0;
+    m_relaidOutBoxCount = 0;
+    m_relayoutBoxes.clear();
+    if(m_dirtyChildStyle && !m_dirtyStyle && !m_dirtyContent) {
+        SelectorFilter selectorFilter;
+        if(m_styleSheet.hasRelativeStateRules()) {
+            for(auto child = firstChild(); child; child = child->nextSibling())
+                child->setSubtreeDirtyStyle();
+            m_dirtyContent = true;
+        } else if(!updateChildrenStyle(selectorFilter)) {
+            m_dirtyContent = true;
+        }
+
+        m_styleSheet.clearStyleCaches();
+    }
+
+    if(!m_dirtyStyle && !m_dirtyContent && !m_dirtyLayout) {
+        if(m_relayoutBoxes.empty())
+            return m_restyledBoxCount > 0;
+        relayout();
+        return true;
+    }
+
+    // A full build recreates the boxes that were rebuilt on their own.
+    m_relayoutBoxes.clear();
+    build();
+    if(m_dirtyLayout) {
+        layout();
+        m_relaidOutBoxCount = countBoxes(box());
+    }
+
+    return true;
 }
 
-void Document::renderPage(GraphicsContext& context, uint32_t pageIndex)
+void Document::relayout()
+{
+    auto view = box();
+    std::vector<BlockFlowBox*> roots;
+    boost::unordered_flat_set<const Box*> rootSet;
+    for(auto box : m_relayoutBoxes) {
+        auto root = BoxView::findLayoutRoot(box);
+        if(root == nullptr) {
+            roots.clear();
+            break;
+        }
+
+        if(rootSet.insert(root).second) {
+            roots.push_back(root);
+        }
+    }
+
+    m_relayoutBoxes.clear();
+    if(!roots.empty()) {
+        // Laying out a root lays out the roots inside it as well.
+        std::vector<BlockFlowBox*> outermostRoots;
+        for(auto root : roots) {
+            auto parent = root->parentBox();
+            while(parent && !rootSet.contains(parent))
+                parent = parent->parentBox();
+            if(parent == nullptr) {
+                outermostRoots.push_back(root);
+            }
+        }
+
+        auto relaidOut = true;
+        for(auto root : outermostRoots) {
+            if(!view->relayout(root)) {
+                relaidOut = false;
+                break;
+            }
+
+            m_relaidOutBoxCount += countBoxes(root);
+        }
+
+        if(relaidOut) {
+            view->updateLayerPosition();
+            return;
+        }
+    }
+
+    m_dirtyLayout = true;
+    layout();
+    m_relaidOutBoxCount = countBoxes(view);
+}
+
+void Document::paginate(bool singlePass)
+{
+    if(m_pageLayout == nullptr)
+        m_pageLayout = std::make_unique<PageLayout>(this);
+    m_pageLayout->layout(singlePass);
+    // The boxes now hold the fragmented layout, so the next call to
+    // layout() has to lay them out continuously again.
+    m_dirtyLayout = true;
+}
+
+void Document::render(GraphicsContext& context, const Rect& rect, const PageBox* page) const
+{
+    box()->paintLayer(PaintInfo(context, rect, page));
+}
+
+void Document::renderPage(GraphicsContext& context, uint32_t pageIndex) const
+{
+    if(auto page = pageAt(pageIndex)) {
+        page->paintLayer(PaintInfo(context, page->pageRect(), page));
+    }
+}
+
+PageBox* Document::pageAt(uint32_t pageIndex) const
+{
+    if(m_pageLayout)
+        return m_pageLayout->pageAt(pageIndex);
+    return nullptr;
+}
+
+void Document::releasePage(uint32_t pageIndex)
 {
     if(pageIndex < m_pages.size()) {
-        const auto& page = m_pages[pageIndex];
-        box()->setCurrentPage(page.get());
-        page->paintLayer(context, page->pageRect());
-        box()->setCurrentPage(nullptr);
+        m_pages[pageIndex].reset();
     }
 }
 
+void Document::clearPages()
+{
+    m_pages.clear();
+    m_pageLayout.reset();
+}
+
 PageSize Document::pageSizeAt(uint32_t pageIndex) const
 {
-    if(pageIndex < m_pages.size())
-        return m_pages[pageIndex]->pageSize();
+    if(pageIndex < pageCount())
+        return m_pageLayout->pageSize();
     return PageSize();
 }
 
 uint32_t Document::pageCount() const
 {
-    return m_pages.size();
+    if(m_pageLayout)
+        return m_pageLayout->pageCount();
+    return 0;
 }
 
 float Document::fragmentHeightForOffset(float offset) const
@@ -1128,9 +1515,17 @@ RefPtr<ResourceType> Document::fetchResource(const Url& url)
     if(url.isEmpty())
         return nullptr;
     auto it = m_resourceCache.find(url);
-    if(it != m_resourceCache.end())
+    if(it != m_resourceCache.end()) {
+        auto errorIt = m_preloadErrors.find(url);
+        if(errorIt != m_preloadErrors.end()) {
+            plutobook_set_error_message("%s", errorIt->second.data());
+            HandleOutputStream(stderr) << "WARNING: " << errorIt->second << '\n';
+            m_preloadErrors.erase(errorIt);
+        }
+
         return to<ResourceType>(it->second);
-    auto resource = ResourceType::create(this, url);
+    }
+    auto resource = to<ResourceType>(loadResource(url, ResourceType::classKind));
     if(!url.protocolIs("data"))
         m_resourceCache.emplace(url, resource);
     if(resource == nullptr)
@@ -2,13 +2,16 @@
 
 #include "css-stylesheet.h"
 #include "fragment-builder.h"
+#include "text-shape.h"
 #include "global-string.h"
 #include "heap-string.h"
+#include "resource.h"
 #include "url.h"
 
 #include <forward_list>
 #include <boost/unordered/unordered_map.hpp>
 #include <boost/unordered/unordered_flat_map.hpp>
+#include <boost/unordered/unordered_node_map.hpp>
 
 namespace plutobook {
     class CssProperty;
@@ -91,9 +94,11 @@ namespace plutobook {
         void setFocus(bool focus) { m_focus = focus; }
 
         void setDirtyStyle();
+        void setSubtreeDirtyStyle();
 
         bool isDirty() const {
-            return m_dirtyStyle || m_dirtyContent || m_dirtyLayout;
+            return m_dirtyStyle || m_dirtyChildStyle || m_dirtyContent ||
+                   m_dirtyLayout;
         }
 
     protected:
@@ -101,6 +106,7 @@ namespace plutobook {
 
         ClassKind m_type : 4;
         unsigned m_dirtyStyle : 1 = true;
+        unsigned m_dirtyChildStyle : 1 = false;
         unsigned m_dirtyContent : 1 = true;
         unsigned m_dirtyLayout : 1 = true;
         unsigned m_active : 1 = false;
@@ -156,6 +162,7 @@ namespace plutobook {
 
         void buildChildrenBox(Counters& counters,
                               SelectorFilter& selectorFilter, Box* parent);
+        bool updateChildrenStyle(SelectorFilter& selectorFilter);
         void finishParsingDocument() override;
 
     private:
@@ -239,7 +246,7 @@ namespace plutobook {
         virtual void parseAttribute(GlobalString name, const HeapString& value);
         virtual void collectAttributeStyle(AttributeStyle& style) const {}
 
-        CssPropertyList inlineStyle() const;
+        const CssPropertyList& inlineStyle() const;
 
         Element* parentElement() const;
         Element* firstChildElement() const;
@@ -262,6 +269,16 @@ namespace plutobook {
         void setHasElementChildren(bool value) { m_hasElementChildren = value; }
         bool hasElementChildren() const { return m_hasElementChildren; }
 
+        // Set by the selector matcher when a rule looked at the position of
+        // one of the children among its siblings or at its content, in
+        // which case the children may not share their styles.
+        void setChildrenAffectedByStructuralRules() const {
+            m_childrenAffectedByStructuralRules = true;
+        }
+        bool childrenAffectedByStructuralRules() const {
+            return m_childrenAffectedByStructuralRules;
+        }
+
         Node* cloneNode(bool deep) override;
         Box* createBox(const RefPtr<BoxStyle>& style) override;
         void buildElementChildrenBox(Counters& counters,
@@ -270,17 +287,23 @@ namespace plutobook {
                       Box* parent) override;
         void finishParsingDocument() override;
 
+        bool updateStyle(SelectorFilter& selectorFilter);
+        bool rebuildBox(SelectorFilter& selectorFilter,
+                        const RefPtr<BoxStyle>& newStyle);
+
     private:
         GlobalString m_namespaceURI;
         GlobalString m_tagName;
         HeapString m_id;
         ClassNameList m_classNames;
         AttributeList m_attributes;
+        mutable const CssPropertyList* m_inlineStyle{nullptr};
 
         bool m_isCaseSensitive{false};
         bool m_isLinkDestination{false};
         bool m_isLinkSource{false};
         bool m_hasElementChildren{false};
+        mutable bool m_childrenAffectedByStructuralRules{false};
     };
 
     extern template bool is<Element>(const Node& value);
@@ -338,6 +361,8 @@ namespace plutobook {
         boost::unordered_flat_map<HeapString, CounterMap, StrHash, StrEqual>;
     using DocumentRunningStyleMap =
         boost::unordered_flat_map<GlobalString, RefPtr<BoxStyle>>;
+    using DocumentInlineStyleMap =
+        boost::unordered_node_map<HeapString, CssPropertyList, StrHash, StrEqual>;
 
     class BoxView;
     class GraphicsContext;
@@ -348,6 +373,7 @@ namespace plutobook {
     class PageSize;
     class PageMargins;
     class PageBox;
+    class PageLayout;
 
     using PageBoxList = std::vector<std::unique_ptr<PageBox>>;
 
@@ -394,6 +420,17 @@ namespace plutobook {
 
         bool setContainerSize(float containerWidth, float containerHeight);
 
+        uint32_t layoutCount() const { return m_layoutCount; }
+        void incrementLayoutCount() { ++m_layoutCount; }
+
+        uint32_t restyledBoxCount() const { return m_restyledBoxCount; }
+        uint32_t relaidOutBoxCount() const { return m_relaidOutBoxCount; }
+        void incrementRestyledBoxCount() { ++m_restyledBoxCount; }
+
+        // Records a box whose children were rebuilt by update(), so that
+        // layout starts again from the nearest layout root above it.
+        void addRelayoutBox(Box* box) { m_relayoutBoxes.push_back(box); }
+
         TextNode* createTextNode(std::string_view value);
         Element* createElement(GlobalString namespaceURI, GlobalString tagName);
 
@@ -434,7 +471,14 @@ namespace plutobook {
 
         CssStyleSheet& styleSheet() { return m_styleSheet; }
 
-        FontDataCache* fontDataCache() { return m_fontDataCache.get(); }
+        // Returns the declarations of a style attribute. Identical
+        // attribute values are parsed once per document and shared.
+        const CssPropertyList& parseInlineStyle(const Element* element,
+                                                const HeapString& value);
+
+        FontDataCache* fontDataCache() const;
+        TextShapeCache& textShapeCache() { return m_textShapeCache; }
+        const TextShapeCache& textShapeCache() const { return m_textShapeCache; }
 
         RefPtr<Font> createFont(const FontDescription& description);
 
@@ -442,6 +486,16 @@ namespace plutobook {
         RefPtr<ImageResource> fetchImageResource(const Url& url);
         RefPtr<FontResource> fetchFontResource(const Url& url);
 
+        struct PreloadRequest {
+            Url url;
+            Resource::Type type;
+        };
+
+        // Fetches the remote resources that are not cached yet concurrently
+        // and adds them to the resource cache, so that a document referring
+        // to many of them does not wait on each one in turn.
+        void preloadResources(const std::vector<PreloadRequest>& requests);
+
         virtual bool parse(std::string_view content) = 0;
 
         Node* cloneNode(bool deep) override;
@@ -454,14 +508,19 @@ namespace plutobook {
 
         void build();
         void layout();
-        void paginate();
+        void paginate(bool singlePass = false);
+
+        bool update();
 
-        void render(GraphicsContext& context, const Rect& rect);
+        void render(GraphicsContext& context, const Rect& rect, const PageBox* page = nullptr) const;
 
         PageBoxList& pages() { return m_pages; }
         const PageBoxList& pages() const { return m_pages; }
+        void releasePage(uint32_t pageIndex);
+        void clearPages();
 
-        void renderPage(GraphicsContext& context, uint32_t pageIndex);
+        PageBox* pageAt(uint32_t pageIndex) const;
+        void renderPage(GraphicsContext& context, uint32_t pageIndex) const;
         PageSize pageSizeAt(uint32_t pageIndex) const;
         uint32_t pageCount() const;
 
@@ -475,23 +534,36 @@ namespace plutobook {
         Rect pageContentRectAt(uint32_t pageIndex) const;
 
     private:
+        void relayout();
+
         template<typename ResourceType>
         RefPtr<ResourceType> fetchResource(const Url& url);
+        RefPtr<Resource> loadResource(const Url& url, Resource::Type type);
+        RefPtr<Resource> createResource(const Url& url, Resource::Type type,
+                                        const ResourceData& data);
         Element* m_rootElement{nullptr};
         Context* m_context;
         ResourceFetcher* m_customResourceFetcher;
         Url m_baseUrl;
         PageBoxList m_pages;
+        std::unique_ptr<PageLayout> m_pageLayout;
         DocumentElementMap m_idCache;
         DocumentResourceMap m_resourceCache;
+        boost::unordered_flat_map<Url, std::string> m_preloadErrors;
         DocumentFontMap m_fontCache;
         DocumentCounterMap m_counterCache;
         DocumentRunningStyleMap m_runningStyles;
+        DocumentInlineStyleMap m_inlineStyles;
+        DocumentInlineStyleMap m_svgInlineStyles;
         CssStyleSheet m_styleSheet;
-        std::unique_ptr<FontDataCache> m_fontDataCache;
+        TextShapeCache m_textShapeCache;
 
         float m_containerWidth{0};
         float m_containerHeight{0};
+        uint32_t m_layoutCount{0};
+        uint32_t m_restyledBoxCount{0};
+        uint32_t m_relaidOutBoxCount{0};
+        std::vector<Box*> m_relayoutBoxes;
 
         std::string m_title;
     };
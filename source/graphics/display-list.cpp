@@ -0,0 +1,380 @@
+#include "display-list.h"
+
+#include <cairo/cairo.h>
+
+#include <algorithm>
+
+namespace plutobook {
+
+DisplayList::~DisplayList()
+{
+    for(auto surface : m_surfaces) {
+        cairo_surface_destroy(surface);
+    }
+}
+
+void DisplayList::setColor(const Color& color)
+{
+    if(m_currentColor == color)
+        return;
+    m_currentColor = color;
+    append(SetColorItem{color});
+}
+
+void DisplayList::setLinearGradient(const LinearGradientValues& values, const GradientInfo& info)
+{
+    m_currentColor.reset();
+    append(SetLinearGradientItem{values, makeGradientItem(info)});
+}
+
+void DisplayList::setRadialGradient(const RadialGradientValues& values, const GradientInfo& info)
+{
+    m_currentColor.reset();
+    append(SetRadialGradientItem{values, makeGradientItem(info)});
+}
+
+void DisplayList::setPattern(cairo_surface_t* surface, const Transform& transform)
+{
+    m_currentColor.reset();
+    append(SetPatternItem{retainSurface(surface), transform});
+}
+
+void DisplayList::translate(float tx, float ty)
+{
+    m_transform.translate(tx, ty);
+    append(TranslateItem{tx, ty});
+}
+
+void DisplayList::scale(float sx, float sy)
+{
+    m_transform.scale(sx, sy);
+    append(ScaleItem{sx, sy});
+}
+
+void DisplayList::rotate(float angle)
+{
+    m_transform.rotate(angle);
+    append(RotateItem{angle});
+}
+
+void DisplayList::addTransform(const Transform& transform)
+{
+    m_transform.multiply(transform);
+    append(AddTransformItem{transform});
+}
+
+void DisplayList::setTransform(const Transform& transform)
+{
+    m_transform = transform;
+    append(SetTransformItem{transform});
+}
+
+void DisplayList::resetTransform()
+{
+    m_transform = Transform();
+    append(ResetTransformItem{});
+}
+
+void DisplayList::fillRect(const Rect& rect)
+{
+    append(FillRectItem{rect}, rect);
+}
+
+void DisplayList::fillRoundedRect(const RoundedRect& rrect)
+{
+    append(FillRoundedRectItem{rrect}, rrect.rect());
+}
+
+void DisplayList::fillPath(const Path& path, FillRule fillRule)
+{
+    append(FillPathItem{path, fillRule}, path.boundingRect());
+}
+
+void DisplayList::fillGlyphs(FontHandle font, const GlyphRef glyphs[], unsigned glyphCount)
+{
+    // Glyphs drawn right after glyphs of the same font, with nothing in
+    // between, share the source and the transform, so they are drawn by
+    // extending the previous item.
+    const auto bounds = glyphBounds(font, glyphs, glyphCount);
+    auto lastItem = m_items.empty() ? nullptr : std::get_if<FillGlyphsItem>(&m_items.back());
+    if(lastItem && lastItem->font == font && lastItem->glyphOffset + lastItem->glyphCount == m_glyphs.size()) {
+        lastItem->glyphCount += glyphCount;
+        m_bounds.back().unite(m_transform.mapRect(bounds));
+    } else {
+        append(FillGlyphsItem{font, m_glyphs.size(), glyphCount}, bounds);
+    }
+
+    m_glyphs.insert(m_glyphs.end(), glyphs, glyphs + glyphCount);
+}
+
+void DisplayList::fillImage(ImageHandle image, const Rect& dstRect, const Rect& srcRect)
+{
+    append(FillImageItem{image, dstRect, srcRect}, dstRect);
+}
+
+void DisplayList::fillImagePattern(ImageHandle image, const Rect& destRect, const Size& size, const Size& scale, const Point& phase)
+{
+    append(FillImagePatternItem{image, destRect, size, scale, phase}, destRect);
+}
+
+void DisplayList::outlineRect(const Rect& rect, float lineWidth)
+{
+    auto bounds = rect;
+    bounds.inflate(lineWidth);
+    append(OutlineRectItem{rect, lineWidth}, bounds);
+}
+
+void DisplayList::outlineRoundedRect(const RoundedRect& rrect, float lineWidth)
+{
+    auto bounds = rrect.rect();
+    bounds.inflate(lineWidth);
+    append(OutlineRoundedRectItem{rrect, lineWidth}, bounds);
+}
+
+void DisplayList::strokePath(const Path& path, const StrokeData& strokeData)
+{
+    // Miter joins reach at most miterLimit half line widths past the path.
+    auto bounds = path.boundingRect();
+    bounds.inflate(strokeData.lineWidth() * std::max(1.f, strokeData.miterLimit()));
+    append(StrokePathItem{path, strokeData}, bounds);
+}
+
+void DisplayList::clipRect(const Rect& rect)
+{
+    append(ClipRectItem{rect});
+}
+
+void DisplayList::clipRoundedRect(const RoundedRect& rrect)
+{
+    append(ClipRoundedRectItem{rrect});
+}
+
+void DisplayList::clipPath(const Path& path, FillRule clipRule)
+{
+    append(ClipPathItem{path, clipRule});
+}
+
+void DisplayList::clipOutRect(const Rect& rect)
+{
+    append(ClipOutRectItem{rect});
+}
+
+void DisplayList::clipOutRoundedRect(const RoundedRect& rrect)
+{
+    append(ClipOutRoundedRectItem{rrect});
+}
+
+void DisplayList::clipOutPath(const Path& path)
+{
+    append(ClipOutPathItem{path});
+}
+
+void DisplayList::save()
+{
+    m_transformStack.push_back(m_transform);
+    append(SaveItem{});
+}
+
+void DisplayList::restore()
+{
+    if(!m_transformStack.empty()) {
+        m_transform = m_transformStack.back();
+        m_transformStack.pop_back();
+    }
+
+    m_currentColor.reset();
+    append(RestoreItem{});
+}
+
+void DisplayList::pushGroup()
+{
+    m_transformStack.push_back(m_transform);
+    append(PushGroupItem{});
+}
+
+void DisplayList::popGroup(float opacity, BlendMode blendMode)
+{
+    if(!m_transformStack.empty()) {
+        m_transform = m_transformStack.back();
+        m_transformStack.pop_back();
+    }
+
+    m_currentColor.reset();
+    append(PopGroupItem{opacity, blendMode});
+}
+
+void DisplayList::applyMask(const ImageBuffer& maskImage)
+{
+    m_currentColor.reset();
+    append(ApplyMaskItem{retainSurface(maskImage.surface()), maskImage.x(), maskImage.y()});
+}
+
+void DisplayList::addLinkAnnotation(std::string_view dest, std::string_view uri, const Rect& rect)
+{
+    if(dest.empty() && uri.empty())
+        return;
+    append(LinkAnnotationItem{std::string(dest), std::string(uri), rect});
+}
+
+void DisplayList::addLinkDestination(std::string_view name, const Point& location)
+{
+    if(name.empty())
+        return;
+    append(LinkDestinationItem{std::string(name), location});
+}
+
+static GradientInfo toGradientInfo(const GradientStops& stops, const Transform& transform, const std::optional<Rect>& objectBoundingBox, SpreadMethod method, float opacity)
+{
+    GradientInfo info;
+    info.stops = stops;
+    info.transform = transform;
+    info.objectBoundingBox = objectBoundingBox ? &*objectBoundingBox : nullptr;
+    info.method = method;
+    info.opacity = opacity;
+    return info;
+}
+
+void DisplayList::replay(CairoGraphicsContext& context, const Rect& rect) const
+{
+    const auto baseTransform = context.getTransform();
+    for(size_t index = 0; index < m_items.size(); ++index) {
+        const auto& item = m_items[index];
+        if(!rect.intersects(m_bounds[index]))
+            continue;
+        if(auto data = std::get_if<SetColorItem>(&item)) {
+            context.setColor(data->color);
+        } else if(auto data = std::get_if<SetLinearGradientItem>(&item)) {
+            const auto& gradient = data->gradient;
+            context.setLinearGradient(data->values, toGradientInfo(gradient.stops, gradient.transform, gradient.objectBoundingBox, gradient.method, gradient.opacity));
+        } else if(auto data = std::get_if<SetRadialGradientItem>(&item)) {
+            const auto& gradient = data->gradient;
+            context.setRadialGradient(data->values, toGradientInfo(gradient.stops, gradient.transform, gradient.objectBoundingBox, gradient.method, gradient.opacity));
+        } else if(auto data = std::get_if<SetPatternItem>(&item)) {
+            context.setPattern(data->surface, data->transform);
+        } else if(auto data = std::get_if<TranslateItem>(&item)) {
+            context.translate(data->tx, data->ty);
+        } else if(auto data = std::get_if<ScaleItem>(&item)) {
+            context.scale(data->sx, data->sy);
+        } else if(auto data = std::get_if<RotateItem>(&item)) {
+            context.rotate(data->angle);
+        } else if(auto data = std::get_if<AddTransformItem>(&item)) {
+            context.addTransform(data->transform);
+        } else if(auto data = std::get_if<SetTransformItem>(&item)) {
+            context.setTransform(baseTransform * data->transform);
+        } else if(std::holds_alternative<ResetTransformItem>(item)) {
+            context.setTransform(baseTransform);
+        } else if(auto data = std::get_if<FillRectItem>(&item)) {
+            context.fillRect(data->rect);
+        } else if(auto data = std::get_if<FillRoundedRectItem>(&item)) {
+            context.fillRoundedRect(data->rrect);
+        } else if(auto data = std::get_if<FillPathItem>(&item)) {
+            context.fillPath(data->path, data->fillRule);
+        } else if(auto data = std::get_if<FillGlyphsItem>(&item)) {
+            context.fillGlyphs(data->font, m_glyphs.data() + data->glyphOffset, data->glyphCount);
+        } else if(auto data = std::get_if<FillImageItem>(&item)) {
+            context.fillImage(data->image, data->dstRect, data->srcRect);
+        } else if(auto data = std::get_if<FillImagePatternItem>(&item)) {
+            context.fillImagePattern(data->image, data->destRect, data->size, data->scale, data->phase);
+        } else if(auto data = std::get_if<OutlineRectItem>(&item)) {
+            context.outlineRect(data->rect, data->lineWidth);
+        } else if(auto data = std::get_if<OutlineRoundedRectItem>(&item)) {
+            context.outlineRoundedRect(data->rrect, data->lineWidth);
+        } else if(auto data = std::get_if<StrokePathItem>(&item)) {
+            context.strokePath(data->path, data->strokeData);
+        } else if(auto data = std::get_if<ClipRectItem>(&item)) {
+            context.clipRect(data->rect);
+        } else if(auto data = std::get_if<ClipRoundedRectItem>(&item)) {
+            context.clipRoundedRect(data->rrect);
+        } else if(auto data = std::get_if<ClipPathItem>(&item)) {
+            context.clipPath(data->path, data->clipRule);
+        } else if(auto data = std::get_if<ClipOutRectItem>(&item)) {
+            context.clipOutRect(data->rect);
+        } else if(auto data = std::get_if<ClipOutRoundedRectItem>(&item)) {
+            context.clipOutRoundedRect(data->rrect);
+        } else if(auto data = std::get_if<ClipOutPathItem>(&item)) {
+            context.clipOutPath(data->path);
+        } else if(std::holds_alternative<SaveItem>(item)) {
+            context.save();
+        } else if(std::holds_alternative<RestoreItem>(item)) {
+            context.restore();
+        } else if(std::holds_alternative<PushGroupItem>(item)) {
+            context.pushGroup();
+        } else if(auto data = std::get_if<PopGroupItem>(&item)) {
+            context.popGroup(data->opacity, data->blendMode);
+        } else if(auto data = std::get_if<ApplyMaskItem>(&item)) {
+            // The mask was rendered in the device space of the recording,
+            // which is the user space the target had when replay started.
+            auto canvas = context.canvas();
+            cairo_matrix_t matrix;
+            cairo_get_matrix(canvas, &matrix);
+            cairo_matrix_t baseMatrix = {
+                baseTransform.a, baseTransform.b, baseTransform.c,
+                baseTransform.d, baseTransform.e, baseTransform.f
+            };
+
+            cairo_set_matrix(canvas, &baseMatrix);
+            cairo_set_source_surface(canvas, data->surface, data->x, data->y);
+            cairo_set_operator(canvas, CAIRO_OPERATOR_DEST_IN);
+            cairo_paint(canvas);
+            cairo_set_operator(canvas, CAIRO_OPERATOR_OVER);
+            cairo_set_matrix(canvas, &matrix);
+        } else if(auto data = std::get_if<LinkAnnotationItem>(&item)) {
+            context.addLinkAnnotation(data->dest, data->uri, data->rect);
+        } else if(auto data = std::get_if<LinkDestinationItem>(&item)) {
+            context.addLinkDestination(data->name, data->location);
+        }
+    }
+}
+
+void DisplayList::append(Item item)
+{
+    m_items.push_back(std::move(item));
+    m_bounds.push_back(Rect::Infinite);
+}
+
+void DisplayList::append(Item item, const Rect& bounds)
+{
+    m_items.push_back(std::move(item));
+    m_bounds.push_back(m_transform.mapRect(bounds));
+}
+
+Rect DisplayList::glyphBounds(FontHandle font, const GlyphRef glyphs[], unsigned glyphCount)
+{
+    if(glyphCount == 0)
+        return Rect::Empty;
+    auto l = glyphs[0].position.x;
+    auto t = glyphs[0].position.y;
+    auto r = l;
+    auto b = t;
+    for(unsigned i = 1; i < glyphCount; ++i) {
+        const auto& position = glyphs[i].position;
+        l = std::min(l, position.x);
+        t = std::min(t, position.y);
+        r = std::max(r, position.x);
+        b = std::max(b, position.y);
+    }
+
+    // The glyph origins are padded by the extents of the font, which
+    // covers the ink of any glyph that does not overhang unusually far.
+    cairo_font_extents_t extents;
+    cairo_scaled_font_extents(CairoGraphicsManager::getScaledFont(font), &extents);
+    Rect bounds(l, t, r - l, b - t);
+    bounds.inflate(extents.max_x_advance + extents.height, extents.height);
+    return bounds;
+}
+
+DisplayList::GradientItem DisplayList::makeGradientItem(const GradientInfo& info)
+{
+    std::optional<Rect> objectBoundingBox;
+    if(info.objectBoundingBox)
+        objectBoundingBox = *info.objectBoundingBox;
+    return GradientItem{info.stops, info.transform, objectBoundingBox, info.method, info.opacity};
+}
+
+cairo_surface_t* DisplayList::retainSurface(cairo_surface_t* surface)
+{
+    m_surfaces.push_back(cairo_surface_reference(surface));
+    return surface;
+}
+
+} // namespace plutobook
@@ -0,0 +1,275 @@
+#pragma once
+
+#include "graphics-context.h"
+
+#include <optional>
+#include <string>
+#include <variant>
+
+namespace plutobook {
+    // A GraphicsContext that records the drawing calls made on it so that
+    // they can be replayed later, any number of times, into a
+    // CairoGraphicsContext. The recorded coordinates are relative to the
+    // transform the target has when replay() is called.
+    //
+    // Fonts and images are recorded by handle and are not retained: they
+    // belong to the resources of the document that was painted, so a list
+    // must be dropped before that document is destroyed.
+    class DisplayList final : public GraphicsContext {
+    public:
+        DisplayList() = default;
+        ~DisplayList();
+
+        void setColor(const Color& color) final;
+        void setLinearGradient(const LinearGradientValues& values,
+                               const GradientInfo& info) final;
+        void setRadialGradient(const RadialGradientValues& values,
+                               const GradientInfo& info) final;
+        void setPattern(cairo_surface_t* surface,
+                        const Transform& transform) final;
+
+        void translate(float tx, float ty) final;
+        void scale(float sx, float sy) final;
+        void rotate(float angle) final;
+
+        Transform getTransform() const final { return m_transform; }
+        void addTransform(const Transform& transform) final;
+        void setTransform(const Transform& transform) final;
+        void resetTransform() final;
+
+        void fillRect(const Rect& rect) final;
+        void fillRoundedRect(const RoundedRect& rrect) final;
+        void fillPath(const Path& path,
+                      FillRule fillRule = FillRule::NonZero) final;
+        void fillGlyphs(FontHandle font, const GlyphRef glyphs[],
+                        unsigned glyphCount) final;
+        void fillImage(ImageHandle image, const Rect& dstRect,
+                       const Rect& srcRect) final;
+        void fillImagePattern(ImageHandle image, const Rect& destRect,
+                              const Size& size, const Size& scale,
+                              const Point& phase) final;
+
+        void outlineRect(const Rect& rect, float lineWidth) final;
+        void outlineRoundedRect(const RoundedRect& rrect,
+                                float lineWidth) final;
+        void strokePath(const Path& path, const StrokeData& strokeData) final;
+
+        void clipRect(const Rect& rect) final;
+        void clipRoundedRect(const RoundedRect& rrect) final;
+        void clipPath(const Path& path,
+                      FillRule clipRule = FillRule::NonZero) final;
+
+        void clipOutRect(const Rect& rect) final;
+        void clipOutRoundedRect(const RoundedRect& rrect) final;
+        void clipOutPath(const Path& path) final;
+
+        void save() final;
+        void restore() final;
+
+        void pushGroup() final;
+        void popGroup(float opacity,
+                      BlendMode blendMode = BlendMode::Normal) final;
+        void applyMask(const ImageBuffer& maskImage) final;
+
+        void addLinkAnnotation(std::string_view dest, std::string_view uri,
+                               const Rect& rect) final;
+        void addLinkDestination(std::string_view name,
+                                const Point& location) final;
+
+        // Replays the items into the context. Drawing items whose bounds, in
+        // the coordinates of the recording, lie outside rect are skipped.
+        void replay(CairoGraphicsContext& context,
+                    const Rect& rect = Rect::Infinite) const;
+
+        bool isEmpty() const { return m_items.empty(); }
+        size_t itemCount() const { return m_items.size(); }
+
+    private:
+        struct SetColorItem {
+            Color color;
+        };
+
+        struct GradientItem {
+            GradientStops stops;
+            Transform transform;
+            std::optional<Rect> objectBoundingBox;
+            SpreadMethod method;
+            float opacity;
+        };
+
+        struct SetLinearGradientItem {
+            LinearGradientValues values;
+            GradientItem gradient;
+        };
+
+        struct SetRadialGradientItem {
+            RadialGradientValues values;
+            GradientItem gradient;
+        };
+
+        struct SetPatternItem {
+            cairo_surface_t* surface;
+            Transform transform;
+        };
+
+        struct TranslateItem {
+            float tx;
+            float ty;
+        };
+
+        struct ScaleItem {
+            float sx;
+            float sy;
+        };
+
+        struct RotateItem {
+            float angle;
+        };
+
+        struct AddTransformItem {
+            Transform transform;
+        };
+
+        struct SetTransformItem {
+            Transform transform;
+        };
+
+        struct ResetTransformItem {};
+
+        struct FillRectItem {
+            Rect rect;
+        };
+
+        struct FillRoundedRectItem {
+            RoundedRect rrect;
+        };
+
+        struct FillPathItem {
+            Path path;
+            FillRule fillRule;
+        };
+
+        struct FillGlyphsItem {
+            FontHandle font;
+            size_t glyphOffset;
+            unsigned glyphCount;
+        };
+
+        struct FillImageItem {
+            ImageHandle image;
+            Rect dstRect;
+            Rect srcRect;
+        };
+
+        struct FillImagePatternItem {
+            ImageHandle image;
+            Rect destRect;
+            Size size;
+            Size scale;
+            Point phase;
+        };
+
+        struct OutlineRectItem {
+            Rect rect;
+            float lineWidth;
+        };
+
+        struct OutlineRoundedRectItem {
+            RoundedRect rrect;
+            float lineWidth;
+        };
+
+        struct StrokePathItem {
+            Path path;
+            StrokeData strokeData;
+        };
+
+        struct ClipRectItem {
+            Rect rect;
+        };
+
+        struct ClipRoundedRectItem {
+            RoundedRect rrect;
+        };
+
+        struct ClipPathItem {
+            Path path;
+            FillRule clipRule;
+        };
+
+        struct ClipOutRectItem {
+            Rect rect;
+        };
+
+        struct ClipOutRoundedRectItem {
+            RoundedRect rrect;
+        };
+
+        struct ClipOutPathItem {
+            Path path;
+        };
+
+        struct SaveItem {};
+        struct RestoreItem {};
+        struct PushGroupItem {};
+
+        struct PopGroupItem {
+            float opacity;
+            BlendMode blendMode;
+        };
+
+        struct ApplyMaskItem {
+            cairo_surface_t* surface;
+            int x;
+            int y;
+        };
+
+        struct LinkAnnotationItem {
+            std::string dest;
+            std::string uri;
+            Rect rect;
+        };
+
+        struct LinkDestinationItem {
+            std::string name;
+            Point location;
+        };
+
+        using Item = std::variant<
+            SetColorItem, SetLinearGradientItem, SetRadialGradientItem,
+            SetPatternItem, TranslateItem, ScaleItem, RotateItem,
+            AddTransformItem, SetTransformItem, ResetTransformItem,
+            FillRectItem, FillRoundedRectItem, FillPathItem, FillGlyphsItem,
+            FillImageItem, FillImagePatternItem, OutlineRectItem,
+            OutlineRoundedRectItem, StrokePathItem, ClipRectItem,
+            ClipRoundedRectItem, ClipPathItem, ClipOutRectItem,
+            ClipOutRoundedRectItem, ClipOutPathItem, SaveItem, RestoreItem,
+            PushGroupItem, PopGroupItem, ApplyMaskItem, LinkAnnotationItem,
+            LinkDestinationItem>;
+
+        void append(Item item);
+        void append(Item item, const Rect& bounds);
+
+        static Rect glyphBounds(FontHandle font, const GlyphRef glyphs[],
+                                unsigned glyphCount);
+        static GradientItem makeGradientItem(const GradientInfo& info);
+        cairo_surface_t* retainSurface(cairo_surface_t* surface);
+
+        std::vector<Item> m_items;
+        // The bounds of each item in the coordinates of the recording, or
+        // Rect::Infinite for the items that change state and are never
+        // skipped.
+        std::vector<Rect> m_bounds;
+        std::vector<GlyphRef> m_glyphs;
+        std::vector<cairo_surface_t*> m_surfaces;
+
+        Transform m_transform;
+        std::vector<Transform> m_transformStack;
+
+        // The color the target will have as its source at this point of the
+        // replay, if the source is known to be a plain color. Setting the
+        // same color again is dropped so that consecutive text runs end up
+        // next to each other and can be merged into one glyph item.
+        std::optional<Color> m_currentColor;
+    };
+} // namespace plutobook
@@ -20,6 +20,7 @@
 #include <stb_image.h>
 
 #include <cmath>
+#include <vector>
 #include "output-stream.h"
 
 namespace plutobook {
@@ -464,8 +465,8 @@ void CairoGraphicsContext::fillPath(const Path& path, FillRule fillRule)
 
 void CairoGraphicsContext::fillGlyphs(FontHandle font, const GlyphRef glyphs[],
                                       unsigned glyphCount) {
-    cairo_set_scaled_font(m_canvas, CairoGraphicsManager::getScaledFont(font));
-    const auto glyphBuffer = cairo_glyph_allocate(glyphCount);
+    thread_local std::vector<cairo_glyph_t> glyphBuffer;
+    glyphBuffer.resize(glyphCount);
     for (unsigned i = 0; i != glyphCount; ++i) {
         const auto& glyphIn = glyphs[i];
         auto& glyphOut = glyphBuffer[i];
@@ -473,8 +474,11 @@ void CairoGraphicsContext::fillGlyphs(FontHandle font, const GlyphRef glyphs[],
         glyphOut.x = glyphIn.position.x;
         glyphOut.y = glyphIn.position.y;
     }
-    cairo_show_glyphs(m_canvas, glyphBuffer, glyphCount);
-    cairo_glyph_free(glyphBuffer);
+
+    cairo_set_scaled_font(m_canvas, CairoGraphicsManager::getScaledFont(font));
+    cairo_show_glyphs(m_canvas, glyphBuffer.data(), glyphCount);
+    m_glyphRunCount += 1;
+    m_glyphCount += glyphCount;
 }
 
 void CairoGraphicsContext::fillImage(ImageHandle image, const Rect& dstRect,
@@ -211,8 +211,15 @@ namespace plutobook {
 
         cairo_t* canvas() const { return m_canvas; }
 
+        // The glyph runs and glyphs drawn through this context. Adjacent
+        // runs with the same font and color reach it as one run.
+        uint64_t glyphRunCount() const { return m_glyphRunCount; }
+        uint64_t glyphCount() const { return m_glyphCount; }
+
     private:
         cairo_t* m_canvas;
+        uint64_t m_glyphRunCount{0};
+        uint64_t m_glyphCount{0};
     };
 
     class ImageBuffer {
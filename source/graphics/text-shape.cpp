@@ -1,11 +1,14 @@
 #include "text-shape.h"
 #include "font-resource.h"
+#include "box-style.h"
+#include "document.h"
 #include "graphics-context.h"
 #include "geometry.h"
 #include "text-break-iterator.h"
 #include "plutobook.hpp"
 
 #include <algorithm>
+#include <utility>
 
 #include <unicode/uchar.h>
 #include <unicode/uscript.h>
@@ -14,23 +17,12 @@
 
 namespace plutobook {
 
-TextShapeRunGlyphDataList::TextShapeRunGlyphDataList(size_t size)
-    : m_data(new TextShapeRunGlyphData[size])
-    , m_size(size)
-{
-}
-
-std::unique_ptr<TextShapeRun> TextShapeRun::create(const SimpleFontData* fontData, uint32_t offset, uint32_t length, float width, TextShapeRunGlyphDataList glyphs)
-{
-    return std::unique_ptr<TextShapeRun>(new TextShapeRun(fontData, offset, length, width, std::move(glyphs)));
-}
-
 TextShapeRun::TextShapeRun(const SimpleFontData* fontData, uint32_t offset, uint32_t length, float width, TextShapeRunGlyphDataList glyphs)
-    : m_fontData(fontData)
+    : m_fontData(const_cast<SimpleFontData*>(fontData))
     , m_offset(offset)
     , m_length(length)
     , m_width(width)
-    , m_glyphs(std::move(glyphs))
+    , m_glyphs(glyphs)
 {
 }
 
@@ -143,23 +135,186 @@ inline float HBFixedToFloat(hb_position_t v) {
     return scalbnf(v, -8);
 }
 
+// Scratch state reused by every shaping call made on a thread. The buffer,
+// the feature list and the glyph arena are reset between text items instead
+// of being reallocated, so they only allocate while growing to fit the
+// largest item seen. Each growth is counted as an allocation.
+class ShapingContext {
+public:
+    struct Run {
+        const SimpleFontData* fontData;
+        uint32_t offset;
+        uint32_t length;
+        float width;
+        size_t glyphOffset;
+        size_t glyphCount;
+    };
+
+    static ShapingContext& current();
+
+    void reset();
+    hb_buffer_t* resetBuffer(uint32_t length);
+    std::vector<hb_feature_t>& resetFeatures(const FontFeatureList& fontFeatures, const FontFeatureList& dataFeatures);
+    TextShapeRunGlyphData* addGlyphs(size_t count);
+    void addRun(const Run& run);
+
+    const std::vector<TextShapeRunGlyphData>& glyphs() const { return m_glyphs; }
+    const std::vector<Run>& runs() const { return m_runs; }
+
+    uint64_t takeAllocationCount() { return std::exchange(m_allocationCount, 0); }
+
+    ~ShapingContext() { hb_buffer_destroy(m_buffer); }
+
+private:
+    ShapingContext();
+    void addFeatures(const FontFeatureList& features);
+
+    hb_buffer_t* m_buffer;
+    uint32_t m_bufferCapacity{0};
+    std::vector<hb_feature_t> m_features;
+    std::vector<TextShapeRunGlyphData> m_glyphs;
+    std::vector<Run> m_runs;
+    uint64_t m_allocationCount{0};
+};
+
+ShapingContext& ShapingContext::current()
+{
+    thread_local ShapingContext context;
+    return context;
+}
+
+void ShapingContext::reset()
+{
+    m_glyphs.clear();
+    m_runs.clear();
+}
+
+hb_buffer_t* ShapingContext::resetBuffer(uint32_t length)
+{
+    // Clearing the buffer keeps its glyph arrays. They are grown up front,
+    // so that the growth can be counted; HarfBuzz still grows them on its
+    // own when an item shapes to more glyphs than it has characters.
+    hb_buffer_reset(m_buffer);
+    if(length > m_bufferCapacity) {
+        hb_buffer_pre_allocate(m_buffer, length);
+        m_bufferCapacity = length;
+        ++m_allocationCount;
+    }
+
+    return m_buffer;
+}
+
+std::vector<hb_feature_t>& ShapingContext::resetFeatures(const FontFeatureList& fontFeatures, const FontFeatureList& dataFeatures)
+{
+    const auto capacity = m_features.capacity();
+    m_features.clear();
+    addFeatures(fontFeatures);
+    addFeatures(dataFeatures);
+    if(m_features.capacity() > capacity)
+        ++m_allocationCount;
+    return m_features;
+}
+
+TextShapeRunGlyphData* ShapingContext::addGlyphs(size_t count)
+{
+    const auto capacity = m_glyphs.capacity();
+    const auto offset = m_glyphs.size();
+    m_glyphs.resize(offset + count);
+    if(m_glyphs.capacity() > capacity)
+        ++m_allocationCount;
+    return m_glyphs.data() + offset;
+}
+
+void ShapingContext::addRun(const Run& run)
+{
+    const auto capacity = m_runs.capacity();
+    m_runs.push_back(run);
+    if(m_runs.capacity() > capacity) {
+        ++m_allocationCount;
+    }
+}
+
+void ShapingContext::addFeatures(const FontFeatureList& features)
+{
+    for(const auto& feature : features) {
+        hb_feature_t hbFeature;
+        hbFeature.tag = feature.first;
+        hbFeature.value = feature.second;
+        hbFeature.start = 0;
+        hbFeature.end = static_cast<unsigned>(-1);
+        m_features.push_back(hbFeature);
+    }
+}
+
+ShapingContext::ShapingContext()
+    : m_buffer(hb_buffer_create())
+{
+    ++m_allocationCount;
+}
+
 RefPtr<TextShape> TextShape::createForText(const UString& text, Direction direction, bool disableSpacing, const BoxStyle* style)
 {
     assert(!text.isEmpty());
-    const auto& font = style->font();
-    const auto fontFeatures = style->fontFeatures();
+    auto font = style->font().get();
+    auto fontFeatures = style->fontFeatures();
     const auto fontVariantEmoji = style->fontVariantEmoji();
     const auto letterSpacing = disableSpacing ? 0 : style->letterSpacing();
     const auto wordSpacing = disableSpacing ? 0 : style->wordSpacing();
+    auto& cache = style->document()->textShapeCache();
+    uint64_t allocationCount = 0;
+    if(text.length() > TextShapeCache::kMaxTextLength) {
+        auto shape = shapeText(text, direction, font, fontFeatures, fontVariantEmoji, letterSpacing, wordSpacing, allocationCount);
+        cache.addAllocationCount(allocationCount);
+        return shape;
+    }
+
+    if(!font->sharedFamilyFonts().empty()) {
+        auto sharedCache = SharedTextShapeCache::instance();
+        SharedTextShapeCache::Key key = {text, &font->sharedFamilyFonts(), &font->description().data, direction, fontVariantEmoji, letterSpacing, wordSpacing, std::move(fontFeatures)};
+        if(auto shape = sharedCache->find(key)) {
+            cache.addSharedLookup(true);
+            return shape;
+        }
+
+        cache.addSharedLookup(false);
+        auto shape = shapeText(text, direction, font, key.fontFeatures, fontVariantEmoji, letterSpacing, wordSpacing, allocationCount);
+        cache.addAllocationCount(allocationCount);
+        sharedCache->add(std::move(key), shape);
+        return shape;
+    }
 
-    const auto hbBuffer = hb_buffer_create();
+    TextShapeCache::Key key = {text, font, direction, fontVariantEmoji, letterSpacing, wordSpacing, std::move(fontFeatures)};
+    if(auto shape = cache.find(key))
+        return shape;
+    auto shape = shapeText(text, direction, font, key.fontFeatures, fontVariantEmoji, letterSpacing, wordSpacing, allocationCount);
+    cache.addAllocationCount(allocationCount);
+    cache.add(std::move(key), shape);
+    return shape;
+}
+
+// Copies the glyphs of every run out of the arena into one block owned by
+// the shape. Building the shape takes at most three allocations: the block,
+// the run list and the shape itself.
+static std::unique_ptr<TextShapeRunGlyphData[]> copyGlyphs(const std::vector<TextShapeRunGlyphData>& glyphs, uint64_t& allocationCount)
+{
+    if(glyphs.empty())
+        return nullptr;
+    std::unique_ptr<TextShapeRunGlyphData[]> data(new TextShapeRunGlyphData[glyphs.size()]);
+    std::copy(glyphs.begin(), glyphs.end(), data.get());
+    ++allocationCount;
+    return data;
+}
+
+RefPtr<TextShape> TextShape::shapeText(const UString& text, Direction direction, Font* font, const FontFeatureList& fontFeatures, FontVariantEmoji fontVariantEmoji, float letterSpacing, float wordSpacing, uint64_t& allocationCount)
+{
+    auto& context = ShapingContext::current();
+    context.reset();
     const auto hbDirection = direction == Direction::Ltr ? HB_DIRECTION_LTR : HB_DIRECTION_RTL;
     const auto textBuffer = reinterpret_cast<const uint16_t*>(text.getBuffer());
 
     float totalWidth = 0.f;
     int startIndex = 0;
     int totalLength = text.length();
-    TextShapeRunList textRuns;
 
     CharacterBreakIterator iterator(text);
     auto character = text.char32At(startIndex);
@@ -199,25 +354,11 @@ RefPtr<TextShape> TextShape::createForText(const UString& text, Direction direct
         auto scriptName = uscript_getShortName(scriptCode);
         auto hbScript = hb_script_from_string(scriptName, -1);
 
-        std::vector<hb_feature_t> hbFeatures;
-        auto addFeatures = [&hbFeatures](const FontFeatureList& features) {
-            for (const auto& feature : features) {
-                hb_feature_t hbFeature;
-                hbFeature.tag = feature.first;
-                hbFeature.value = feature.second;
-                hbFeature.start = 0;
-                hbFeature.end = static_cast<unsigned>(-1);
-                hbFeatures.push_back(hbFeature);
-            }
-        };
-
-        addFeatures(fontFeatures);
-        addFeatures(fontData->features());
-
+        const auto& hbFeatures = context.resetFeatures(fontFeatures, fontData->features());
         while (numCharacters > 0) {
             const auto itemLength = std::min(numCharacters, kMaxCharacters);
 
-            hb_buffer_reset(hbBuffer);
+            const auto hbBuffer = context.resetBuffer(itemLength);
             hb_buffer_add_utf16(hbBuffer, textBuffer + startIndex, itemLength, 0, itemLength);
             hb_buffer_set_direction(hbBuffer, hbDirection);
             hb_buffer_set_script(hbBuffer, hbScript);
@@ -228,7 +369,8 @@ RefPtr<TextShape> TextShape::createForText(const UString& text, Direction direct
             auto numGlyphs = hb_buffer_get_length(hbBuffer);
 
             float width = 0.f;
-            TextShapeRunGlyphDataList glyphs(numGlyphs);
+            const auto glyphOffset = context.glyphs().size();
+            auto glyphs = context.addGlyphs(numGlyphs);
             for (size_t index = 0; index < numGlyphs; ++index) {
                 const auto& glyphInfo = glyphInfos[index];
                 const auto& glyphPosition = glyphPositions[index];
@@ -252,19 +394,30 @@ RefPtr<TextShape> TextShape::createForText(const UString& text, Direction direct
                 width += glyphData.advance;
             }
 
-            auto textRun = TextShapeRun::create(fontData, startIndex, itemLength, width, std::move(glyphs));
+            context.addRun({fontData, uint32_t(startIndex), uint32_t(itemLength), width, glyphOffset, numGlyphs});
             totalWidth += width;
             startIndex += itemLength;
             totalLength -= itemLength;
             numCharacters -= itemLength;
-            textRuns.push_back(std::move(textRun));
         }
     }
 
-    hb_buffer_destroy(hbBuffer);
+    auto glyphStorage = copyGlyphs(context.glyphs(), allocationCount);
+    TextShapeRunList textRuns;
+    if(!context.runs().empty()) {
+        textRuns.reserve(context.runs().size());
+        ++allocationCount;
+    }
+
+    for(const auto& run : context.runs()) {
+        TextShapeRunGlyphDataList glyphs(glyphStorage.get() + run.glyphOffset, run.glyphCount);
+        textRuns.emplace_back(run.fontData, run.offset, run.length, run.width, glyphs);
+    }
+
     if (direction == Direction::Rtl)
         std::reverse(textRuns.begin(), textRuns.end());
-    return adoptPtr(new TextShape(text, direction, totalWidth, std::move(textRuns)));
+    allocationCount += context.takeAllocationCount() + 1;
+    return adoptPtr(new TextShape(text, direction, totalWidth, std::move(glyphStorage), std::move(textRuns)));
 }
 
 RefPtr<TextShape> TextShape::createForTabs(const UString& text, Direction direction, const BoxStyle* style)
@@ -275,13 +428,18 @@ RefPtr<TextShape> TextShape::createForTabs(const UString& text, Direction direct
     int startIndex = 0;
     int totalLength = text.length();
 
+    uint64_t allocationCount = 0;
+    std::unique_ptr<TextShapeRunGlyphData[]> glyphStorage;
     TextShapeRunList runs;
     if (auto fontData = font->getFontData(kSpaceCharacter, 0)) {
         auto tabWidth = style->tabWidth(fontData->spaceWidth());
         auto spaceGlyph = fontData->spaceGlyph();
+        glyphStorage.reset(new TextShapeRunGlyphData[totalLength]);
+        runs.reserve((totalLength + kMaxGlyphs - 1) / kMaxGlyphs);
+        allocationCount += 2;
         while(totalLength > 0) {
             auto numGlyphs = std::min(totalLength, kMaxGlyphs);
-            TextShapeRunGlyphDataList glyphs(numGlyphs);
+            auto glyphs = glyphStorage.get() + startIndex;
             for(int index = 0; index < numGlyphs; ++index) {
                 assert(text[index + startIndex] == kTabulationCharacter);
                 auto& glyphData = glyphs[index];
@@ -292,15 +450,15 @@ RefPtr<TextShape> TextShape::createForTabs(const UString& text, Direction direct
                 glyphData.advance = tabWidth;
             }
 
-            auto run = TextShapeRun::create(fontData, startIndex, numGlyphs, numGlyphs * tabWidth, std::move(glyphs));
-            totalWidth += run->width();
+            auto& run = runs.emplace_back(fontData, startIndex, numGlyphs, numGlyphs * tabWidth, TextShapeRunGlyphDataList(glyphs, numGlyphs));
+            totalWidth += run.width();
             startIndex += numGlyphs;
             totalLength -= numGlyphs;
-            runs.push_back(std::move(run));
         }
     }
 
-    return adoptPtr(new TextShape(text, direction, totalWidth, std::move(runs)));
+    style->document()->textShapeCache().addAllocationCount(allocationCount + 1);
+    return adoptPtr(new TextShape(text, direction, totalWidth, std::move(glyphStorage), std::move(runs)));
 }
 
 uint32_t TextShape::offsetForPosition(float position) const
@@ -311,13 +469,13 @@ uint32_t TextShape::offsetForPosition(float position) const
     float currentPosition = 0;
     for(const auto& run : m_runs) {
         if(m_direction == Direction::Rtl)
-            currentOffset -= run->length();
+            currentOffset -= run.length();
         auto runPosition = position - currentPosition;
-        if(runPosition >= 0.f && runPosition <= run->width())
-            return currentOffset + run->offsetForPosition(runPosition, m_direction);
+        if(runPosition >= 0.f && runPosition <= run.width())
+            return currentOffset + run.offsetForPosition(runPosition, m_direction);
         if(m_direction == Direction::Ltr)
-            currentOffset += run->length();
-        currentPosition += run->width();
+            currentOffset += run.length();
+        currentPosition += run.width();
     }
 
     return currentOffset;
@@ -333,13 +491,13 @@ float TextShape::positionForOffset(uint32_t offset) const
     float position = 0;
     float currentPosition = 0;
     for(const auto& run : m_runs) {
-        if(currentOffset < run->length()) {
-            position = currentPosition + run->positionForVisualOffset(currentOffset, m_direction);
+        if(currentOffset < run.length()) {
+            position = currentPosition + run.positionForVisualOffset(currentOffset, m_direction);
             break;
         }
 
-        currentOffset -= run->length();
-        currentPosition += run->width();
+        currentOffset -= run.length();
+        currentPosition += run.width();
     }
 
     if(!position && offset == m_text.length())
@@ -349,14 +507,81 @@ float TextShape::positionForOffset(uint32_t offset) const
 
 TextShape::~TextShape() = default;
 
-TextShape::TextShape(const UString& text, Direction direction, float width, TextShapeRunList runs)
+TextShape::TextShape(const UString& text, Direction direction, float width, std::unique_ptr<TextShapeRunGlyphData[]> glyphs, TextShapeRunList runs)
     : m_text(text)
     , m_direction(direction)
     , m_width(width)
+    , m_glyphs(std::move(glyphs))
     , m_runs(std::move(runs))
 {
 }
 
+RefPtr<TextShape> TextShapeCache::find(const Key& key)
+{
+    auto it = m_table.find(key);
+    if(it == m_table.end()) {
+        ++m_missCount;
+        return nullptr;
+    }
+
+    ++m_hitCount;
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return it->second->shape;
+}
+
+void TextShapeCache::add(Key&& key, const RefPtr<TextShape>& shape)
+{
+    if(m_entries.size() >= kMaxEntryCount) {
+        m_table.erase(m_entries.back().key);
+        m_entries.pop_back();
+    }
+
+    m_entries.push_front({key, shape});
+    m_table.emplace(std::move(key), m_entries.begin());
+}
+
+void TextShapeCache::clear()
+{
+    m_table.clear();
+    m_entries.clear();
+}
+
+SharedTextShapeCache* SharedTextShapeCache::instance()
+{
+    static SharedTextShapeCache cache;
+    return &cache;
+}
+
+RefPtr<TextShape> SharedTextShapeCache::find(const Key& key)
+{
+    std::lock_guard guard(m_mutex);
+    auto it = m_table.find(key);
+    if(it == m_table.end())
+        return nullptr;
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return it->second->shape;
+}
+
+void SharedTextShapeCache::add(Key&& key, const RefPtr<TextShape>& shape)
+{
+    std::lock_guard guard(m_mutex);
+    // Another thread may have shaped the same text in the meantime.
+    if(m_table.contains(key))
+        return;
+    if(m_entries.size() >= kMaxEntryCount) {
+        m_table.erase(m_entries.back().key);
+        m_entries.pop_back();
+    }
+
+    FontDataList fonts(*key.fonts);
+    FontDataDescription description(*key.description);
+    m_entries.push_front({std::move(key), std::move(fonts), std::move(description), shape});
+    auto& entry = m_entries.front();
+    entry.key.fonts = &entry.fonts;
+    entry.key.description = &entry.description;
+    m_table.emplace(entry.key, m_entries.begin());
+}
+
 UString TextShapeView::text() const
 {
     if(m_shape)
@@ -372,10 +597,10 @@ uint32_t TextShapeView::expansionOpportunityCount() const
     auto direction = m_shape->direction();
     const auto& text = m_shape->text();
     for(const auto& run : m_shape->runs()) {
-        const auto& glyphs = run->glyphs();
+        const auto& glyphs = run.glyphs();
         for(uint32_t glyphIndex = 0; glyphIndex < glyphs.size(); ++glyphIndex) {
             const auto& glyph = glyphs[glyphIndex];
-            auto characterIndex = glyph.characterIndex + run->offset();
+            auto characterIndex = glyph.characterIndex + run.offset();
             if((direction == Direction::Ltr && characterIndex >= m_endOffset)
                 || (direction == Direction::Rtl && characterIndex < m_startOffset)) {
                 break;
@@ -400,10 +625,10 @@ void TextShapeView::maxAscentAndDescent(float& maxAscent, float& maxDescent) con
         return;
     auto direction = m_shape->direction();
     for(const auto& run : m_shape->runs()) {
-        const auto& glyphs = run->glyphs();
+        const auto& glyphs = run.glyphs();
         for(uint32_t glyphIndex = 0; glyphIndex < glyphs.size(); ++glyphIndex) {
             const auto& glyph = glyphs[glyphIndex];
-            auto characterIndex = glyph.characterIndex + run->offset();
+            auto characterIndex = glyph.characterIndex + run.offset();
             if((direction == Direction::Ltr && characterIndex >= m_endOffset)
                 || (direction == Direction::Rtl && characterIndex < m_startOffset)) {
                 break;
@@ -411,8 +636,8 @@ void TextShapeView::maxAscentAndDescent(float& maxAscent, float& maxDescent) con
 
             if((direction == Direction::Ltr && characterIndex >= m_startOffset)
                 || (direction == Direction::Rtl && characterIndex < m_endOffset)) {
-                maxAscent = std::max(maxAscent, run->fontData()->ascent());
-                maxDescent = std::max(maxDescent, run->fontData()->descent());
+                maxAscent = std::max(maxAscent, run.fontData()->ascent());
+                maxDescent = std::max(maxDescent, run.fontData()->descent());
             }
         }
     }
@@ -426,10 +651,10 @@ float TextShapeView::width(float expansion) const
     auto direction = m_shape->direction();
     const auto& text = m_shape->text();
     for(const auto& run : m_shape->runs()) {
-        const auto& glyphs = run->glyphs();
+        const auto& glyphs = run.glyphs();
         for(uint32_t glyphIndex = 0; glyphIndex < glyphs.size(); ++glyphIndex) {
             const auto& glyph = glyphs[glyphIndex];
-            auto characterIndex = glyph.characterIndex + run->offset();
+            auto characterIndex = glyph.characterIndex + run.offset();
             if((direction == Direction::Ltr && characterIndex >= m_endOffset)
                 || (direction == Direction::Rtl && characterIndex < m_startOffset)) {
                 break;
@@ -458,11 +683,11 @@ float TextShapeView::draw(GraphicsContext& context, const Point& origin, float e
     const auto& text = m_shape->text();
     std::vector<GlyphRef> glyphBuffer;
     for(const auto& run : m_shape->runs()) {
-        const auto& glyphs = run->glyphs();
+        const auto& glyphs = run.glyphs();
         glyphBuffer.reserve(glyphs.size());
         for(uint32_t glyphIndex = 0; glyphIndex < glyphs.size(); ++glyphIndex) {
             const auto& glyph = glyphs[glyphIndex];
-            const auto characterIndex = glyph.characterIndex + run->offset();
+            const auto characterIndex = glyph.characterIndex + run.offset();
             if((direction == Direction::Ltr && characterIndex >= m_endOffset)
                 || (direction == Direction::Rtl && characterIndex < m_startOffset)) {
                 break;
@@ -487,7 +712,7 @@ float TextShapeView::draw(GraphicsContext& context, const Point& origin, float e
         }
 
         if (const auto glyphCount = glyphBuffer.size()) {
-            context.fillGlyphs(run->fontData()->font(), glyphBuffer.data(),
+            context.fillGlyphs(run.fontData()->font(), glyphBuffer.data(),
                                glyphCount);
             glyphBuffer.clear();
         }
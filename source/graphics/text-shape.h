@@ -3,9 +3,14 @@
 #include "pointer.h"
 #include "heap-string.h"
 #include "ustring.h"
+#include "graphics-manager.h"
+#include "font-resource.h"
 
+#include <list>
 #include <memory>
+#include <mutex>
 #include <vector>
+#include <boost/unordered/unordered_flat_map.hpp>
 
 namespace plutobook {
     struct TextShapeRunGlyphData {
@@ -16,20 +21,20 @@ namespace plutobook {
         float advance;
     };
 
+    // A view of the glyphs of one run. The glyphs of every run of a
+    // TextShape are held in a single block owned by the shape.
     class TextShapeRunGlyphDataList {
     public:
-        explicit TextShapeRunGlyphDataList(size_t size);
+        TextShapeRunGlyphDataList(const TextShapeRunGlyphData* data, size_t size)
+            : m_data(data), m_size(size) {}
 
-        TextShapeRunGlyphData& operator[](size_t index) {
-            return m_data[index];
-        }
         const TextShapeRunGlyphData& operator[](size_t index) const {
             return m_data[index];
         }
         size_t size() const { return m_size; }
 
     private:
-        std::unique_ptr<TextShapeRunGlyphData[]> m_data;
+        const TextShapeRunGlyphData* m_data;
         size_t m_size;
     };
 
@@ -39,11 +44,11 @@ namespace plutobook {
 
     class TextShapeRun {
     public:
-        static std::unique_ptr<TextShapeRun>
-        create(const SimpleFontData* fontData, uint32_t offset, uint32_t length,
-               float width, TextShapeRunGlyphDataList glyphs);
+        TextShapeRun(const SimpleFontData* fontData, uint32_t offset,
+                     uint32_t length, float width,
+                     TextShapeRunGlyphDataList glyphs);
 
-        const SimpleFontData* fontData() const { return m_fontData; }
+        const SimpleFontData* fontData() const { return m_fontData.get(); }
         uint32_t offset() const { return m_offset; }
         uint32_t length() const { return m_length; }
         float width() const { return m_width; }
@@ -55,19 +60,21 @@ namespace plutobook {
         uint32_t offsetForPosition(float position, Direction direction) const;
 
     private:
-        TextShapeRun(const SimpleFontData* fontData, uint32_t offset,
-                     uint32_t length, float width,
-                     TextShapeRunGlyphDataList glyphs);
-        const SimpleFontData* m_fontData;
+        // Held by reference, since a shape shared between documents may
+        // use a fallback font that no Font of the current document holds.
+        RefPtr<SimpleFontData> m_fontData;
         uint32_t m_offset;
         uint32_t m_length;
         float m_width;
         TextShapeRunGlyphDataList m_glyphs;
     };
 
-    using TextShapeRunList = std::vector<std::unique_ptr<TextShapeRun>>;
+    using TextShapeRunList = std::vector<TextShapeRun>;
 
     class BoxStyle;
+    class Font;
+
+    enum class FontVariantEmoji : uint8_t;
 
     class TextShape : public RefCounted<TextShape> {
     public:
@@ -92,13 +99,154 @@ namespace plutobook {
 
     private:
         TextShape(const UString& text, Direction direction, float width,
+                  std::unique_ptr<TextShapeRunGlyphData[]> glyphs,
                   TextShapeRunList runs);
+        static RefPtr<TextShape>
+        shapeText(const UString& text, Direction direction, Font* font,
+                  const FontFeatureList& fontFeatures,
+                  FontVariantEmoji fontVariantEmoji, float letterSpacing,
+                  float wordSpacing, uint64_t& allocationCount);
+
         UString m_text;
         Direction m_direction;
         float m_width;
+        std::unique_ptr<TextShapeRunGlyphData[]> m_glyphs;
         TextShapeRunList m_runs;
     };
 
+    // Keeps the most recently shaped text items of a document whose font
+    // uses an @font-face family, so that a word repeated in the same font
+    // and spacing is only shaped once. Fonts live as long as their
+    // document, so the key holds them by address. Text in every other font
+    // goes through the SharedTextShapeCache instead.
+    class TextShapeCache {
+    public:
+        struct Key {
+            UString text;
+            const Font* font{nullptr};
+            Direction direction;
+            FontVariantEmoji fontVariantEmoji;
+            float letterSpacing{0};
+            float wordSpacing{0};
+            FontFeatureList fontFeatures;
+
+            bool operator==(const Key& other) const = default;
+
+            friend std::size_t hash_value(const Key& self) {
+                std::size_t seed = self.text.hashCode();
+                boost::hash_combine(seed, self.font);
+                boost::hash_combine(seed, self.direction);
+                boost::hash_combine(seed, self.fontVariantEmoji);
+                boost::hash_combine(seed, self.letterSpacing);
+                boost::hash_combine(seed, self.wordSpacing);
+                boost::hash_combine(seed, self.fontFeatures);
+                return seed;
+            }
+        };
+
+        static constexpr uint32_t kMaxTextLength = 128;
+
+        TextShapeCache() = default;
+
+        RefPtr<TextShape> find(const Key& key);
+        void add(Key&& key, const RefPtr<TextShape>& shape);
+        void clear();
+
+        // Counts a lookup made in the SharedTextShapeCache for the document,
+        // so that the hit and miss counts cover every cacheable text item.
+        void addSharedLookup(bool hit) { ++(hit ? m_hitCount : m_missCount); }
+
+        uint32_t hitCount() const { return m_hitCount; }
+        uint32_t missCount() const { return m_missCount; }
+
+        // Heap allocations made while shaping the text items of the
+        // document, whether they went through the cache or not.
+        uint64_t allocationCount() const { return m_allocationCount; }
+        void addAllocationCount(uint64_t count) { m_allocationCount += count; }
+
+    private:
+        static constexpr size_t kMaxEntryCount = 4096;
+
+        struct Entry {
+            Key key;
+            RefPtr<TextShape> shape;
+        };
+
+        using EntryList = std::list<Entry>;
+
+        EntryList m_entries;
+        boost::unordered_flat_map<Key, EntryList::iterator> m_table;
+        uint32_t m_hitCount{0};
+        uint32_t m_missCount{0};
+        uint64_t m_allocationCount{0};
+    };
+
+    // Keeps the most recently shaped text items of the process whose font
+    // has no @font-face family, so that documents set in the same system
+    // fonts share their shapes. The key holds the family fonts and the font
+    // description by address; for a lookup they belong to the Font, and
+    // for an entry to the entry itself, which keeps the fonts alive so that
+    // their addresses are not reused.
+    class SharedTextShapeCache {
+    public:
+        struct Key {
+            UString text;
+            const FontDataList* fonts{nullptr};
+            const FontDataDescription* description{nullptr};
+            Direction direction;
+            FontVariantEmoji fontVariantEmoji;
+            float letterSpacing{0};
+            float wordSpacing{0};
+            FontFeatureList fontFeatures;
+
+            bool operator==(const Key& other) const {
+                return text == other.text && *fonts == *other.fonts
+                    && *description == *other.description
+                    && direction == other.direction
+                    && fontVariantEmoji == other.fontVariantEmoji
+                    && letterSpacing == other.letterSpacing
+                    && wordSpacing == other.wordSpacing
+                    && fontFeatures == other.fontFeatures;
+            }
+
+            friend std::size_t hash_value(const Key& self) {
+                std::size_t seed = self.text.hashCode();
+                for(const auto& font : *self.fonts)
+                    boost::hash_combine(seed, font.get());
+                boost::hash_combine(seed, *self.description);
+                boost::hash_combine(seed, self.direction);
+                boost::hash_combine(seed, self.fontVariantEmoji);
+                boost::hash_combine(seed, self.letterSpacing);
+                boost::hash_combine(seed, self.wordSpacing);
+                boost::hash_combine(seed, self.fontFeatures);
+                return seed;
+            }
+        };
+
+        static SharedTextShapeCache* instance();
+
+        RefPtr<TextShape> find(const Key& key);
+        void add(Key&& key, const RefPtr<TextShape>& shape);
+
+    private:
+        SharedTextShapeCache() = default;
+
+        static constexpr size_t kMaxEntryCount = 16384;
+
+        struct Entry {
+            Key key;
+            FontDataList fonts;
+            FontDataDescription description;
+            RefPtr<TextShape> shape;
+        };
+
+        using EntryList = std::list<Entry>;
+
+        std::mutex m_mutex;
+        EntryList m_entries;
+        boost::unordered_flat_map<Key, EntryList::iterator> m_table;
+    };
+
     class GraphicsContext;
     class Point;
 
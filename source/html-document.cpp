@@ -158,8 +158,10 @@ void HtmlElement::buildElementBox(Counters& counters, SelectorFilter& selectorFi
 void HtmlElement::buildBox(Counters& counters, SelectorFilter& selectorFilter, Box* parent)
 {
     RefPtr<BoxStyle> style(Node::style());
+    m_dirtyChildStyle = false;
     if (m_dirtyStyle) {
         m_dirtyStyle = false;
+        document()->incrementRestyledBoxCount();
         auto newStyle = document()->styleSheet().styleForElement(this, selectorFilter, parent->style());
         if (!isSame(style, newStyle)) {
             style = std::move(newStyle);
@@ -1017,6 +1019,50 @@ bool HtmlDocument::parse(std::string_view content)
     return HtmlParser(this, content).parse();
 }
 
+// Collects the style sheets and images the document is going to fetch,
+// resolving them the way the elements do: style sheets are fetched while
+// the parsing finishes, against the base url in effect at their position,
+// and images once the boxes are built, against the final base url.
+static void collectPreloadRequests(const Node* node, Url& baseUrl, std::vector<Document::PreloadRequest>& requests, std::vector<const HeapString*>& imageSources)
+{
+    for(auto child = node->firstChild(); child; child = child->nextSibling()) {
+        auto element = to<HtmlElement>(child);
+        if(element == nullptr)
+            continue;
+        if(element->tagName() == baseTag) {
+            Url url(element->getAttribute(hrefAttr));
+            if(!url.isEmpty()) {
+                baseUrl = std::move(url);
+            }
+        } else if(element->tagName() == linkTag) {
+            auto link = static_cast<const HtmlLinkElement*>(element);
+            const auto& href = link->getAttribute(hrefAttr);
+            if(!href.empty() && iequals(link->rel(), "stylesheet") && link->document()->supportsMedia(link->type(), link->media())) {
+                requests.emplace_back(baseUrl.complete(href), Resource::Type::Text);
+            }
+        } else if(element->tagName() == imgTag) {
+            const auto& src = element->getAttribute(srcAttr);
+            if(!src.empty()) {
+                imageSources.push_back(&src);
+            }
+        }
+
+        collectPreloadRequests(element, baseUrl, requests, imageSources);
+    }
+}
+
+void HtmlDocument::finishParsingDocument()
+{
+    Url finalBaseUrl(baseUrl());
+    std::vector<PreloadRequest> requests;
+    std::vector<const HeapString*> imageSources;
+    collectPreloadRequests(this, finalBaseUrl, requests, imageSources);
+    for(auto src : imageSources)
+        requests.emplace_back(finalBaseUrl.complete(*src), Resource::Type::Image);
+    preloadResources(requests);
+    Document::finishParsingDocument();
+}
+
 HtmlDocument::HtmlDocument(Context* context, ResourceFetcher* fetcher, Url baseUrl)
     : Document(classKind, context, fetcher, std::move(baseUrl))
 {
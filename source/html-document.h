@@ -251,6 +251,7 @@ namespace plutobook {
         create(Context* context, ResourceFetcher* fetcher, Url baseUrl);
 
         bool parse(std::string_view content) final;
+        void finishParsingDocument() final;
 
     private:
         HtmlDocument(Context* context, ResourceFetcher* fetcher, Url baseUrl);
@@ -519,8 +519,29 @@ Optional<float> BlockBox::inlineBlockBaseline() const
     return std::nullopt;
 }
 
+void BlockBox::buildPaintIndex()
+{
+    m_paintIndex.clear();
+    for(auto child = firstBoxFrame(); child; child = child->nextBoxFrame()) {
+        if(!child->isFloating() && !child->hasLayer()) {
+            auto overflowRect = child->visualOverflowRect();
+            overflowRect.translate(child->location());
+            m_paintIndex.add(child, overflowRect.y, overflowRect.bottom());
+        }
+    }
+
+    m_paintIndex.build();
+}
+
 void BlockBox::paintContents(const PaintInfo& info, const Point& offset, PaintPhase phase)
 {
+    if(!m_paintIndex.isEmpty()) {
+        const auto& rect = info.rect();
+        for(auto child : m_paintIndex.query(rect.y - offset.y, rect.bottom() - offset.y))
+            child->paint(info, offset, phase);
+        return;
+    }
+
     for(auto child = firstBoxFrame(); child; child = child->nextBoxFrame()) {
         if(!child->isFloating() && !child->hasLayer()) {
             child->paint(info, offset, phase);
@@ -1636,6 +1657,14 @@ void BlockFlowBox::paintFloats(const PaintInfo& info, const Point& offset)
     }
 }
 
+void BlockFlowBox::buildPaintIndex()
+{
+    if(isChildrenInline())
+        m_lineLayout->buildPaintIndex();
+    else
+        BlockBox::buildPaintIndex();
+}
+
 void BlockFlowBox::paintContents(const PaintInfo& info, const Point& offset, PaintPhase phase)
 {
     if(isChildrenInline())
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "box.h"
+#include "paint-index.h"
 
 #include <boost/unordered/unordered_flat_set.hpp>
 
@@ -93,6 +94,7 @@ namespace plutobook {
         Optional<float> lastLineBaseline() const override;
         Optional<float> inlineBlockBaseline() const override;
 
+        virtual void buildPaintIndex();
         virtual void paintContents(const PaintInfo& info, const Point& offset,
                                    PaintPhase phase);
         void paint(const PaintInfo& info, const Point& offset,
@@ -102,6 +104,7 @@ namespace plutobook {
 
     private:
         PositionedBoxList m_positionedBoxes;
+        PaintIndex<BoxFrame*> m_paintIndex;
     };
 
     extern template bool is<BlockBox>(const Box& value);
@@ -276,6 +279,7 @@ namespace plutobook {
 
         void build() override;
 
+        void buildPaintIndex() override;
         void paintFloats(const PaintInfo& info, const Point& offset);
         void paintContents(const PaintInfo& info, const Point& offset,
                            PaintPhase phase) override;
@@ -68,13 +68,16 @@ void BoxLayer::updateLayerPosition()
     }
 }
 
-void BoxLayer::paint(GraphicsContext& context, const Rect& rect)
+void BoxLayer::paint(const PaintInfo& info)
 {
-    paintLayer(this, context, rect);
+    paintLayer(this, info);
 }
 
-void BoxLayer::paintLayer(BoxLayer* rootLayer, GraphicsContext& context, const Rect& rect)
+void BoxLayer::paintLayer(BoxLayer* rootLayer, const PaintInfo& info)
 {
+    auto& context = info.context();
+    const auto& rect = info.rect();
+
     Point location;
     auto currentLayer = this;
     while(currentLayer && currentLayer != rootLayer) {
@@ -84,7 +87,7 @@ void BoxLayer::paintLayer(BoxLayer* rootLayer, GraphicsContext& context, const R
 
     if(m_box->isMultiColumnFlowBox()) {
         assert(m_box->style()->position() == Position::Static && !m_box->hasTransform());
-        paintLayerColumnContents(rootLayer, context, rect, location);
+        paintLayerColumnContents(rootLayer, info, location);
         return;
     }
 
@@ -94,7 +97,7 @@ void BoxLayer::paintLayer(BoxLayer* rootLayer, GraphicsContext& context, const R
     }
 
     if(!m_box->hasTransform() && !m_box->isPageMarginBox()) {
-        paintLayerContents(rootLayer, context, rect, location);
+        paintLayerContents(rootLayer, info, location);
         return;
     }
 
@@ -106,12 +109,13 @@ void BoxLayer::paintLayer(BoxLayer* rootLayer, GraphicsContext& context, const R
 
     context.save();
     context.addTransform(transform);
-    paintLayerContents(this, context, rectangle, Point());
+    paintLayerContents(this, PaintInfo(context, rectangle, info.page()), Point());
     context.restore();
 }
 
-void BoxLayer::paintLayerContents(BoxLayer* rootLayer, GraphicsContext& context, const Rect& rect, const Point& offset)
+void BoxLayer::paintLayerContents(BoxLayer* rootLayer, const PaintInfo& info, const Point& offset)
 {
+    auto& context = info.context();
     Rect clipRect(offset.x, offset.y, m_borderRect.w, m_borderRect.h);
     auto clipping = m_box->isOverflowHidden() && !m_box->isSvgRootBox();
     if(m_box->isPositioned()) {
@@ -153,11 +157,10 @@ void BoxLayer::paintLayerContents(BoxLayer* rootLayer, GraphicsContext& context,
         context.pushGroup();
     }
 
-    PaintInfo paintInfo(context, rect);
-    m_box->paintRootBackground(paintInfo);
+    m_box->paintRootBackground(info);
     for(auto child : m_children) {
         if(child->zIndex() < 0) {
-            child->paintLayer(rootLayer, context, rect);
+            child->paintLayer(rootLayer, info);
         }
     }
 
@@ -167,13 +170,13 @@ void BoxLayer::paintLayerContents(BoxLayer* rootLayer, GraphicsContext& context,
         adjustedOffset.translate(-box.location());
     }
 
-    m_box->paint(paintInfo, adjustedOffset, PaintPhase::Decorations);
-    m_box->paint(paintInfo, adjustedOffset, PaintPhase::Floats);
-    m_box->paint(paintInfo, adjustedOffset, PaintPhase::Contents);
-    m_box->paint(paintInfo, adjustedOffset, PaintPhase::Outlines);
+    m_box->paint(info, adjustedOffset, PaintPhase::Decorations);
+    m_box->paint(info, adjustedOffset, PaintPhase::Floats);
+    m_box->paint(info, adjustedOffset, PaintPhase::Contents);
+    m_box->paint(info, adjustedOffset, PaintPhase::Outlines);
     for(auto child : m_children) {
         if(child->zIndex() >= 0) {
-            child->paintLayer(rootLayer, context, rect);
+            child->paintLayer(rootLayer, info);
         }
     }
 
@@ -184,8 +187,10 @@ void BoxLayer::paintLayerContents(BoxLayer* rootLayer, GraphicsContext& context,
     }
 }
 
-void BoxLayer::paintLayerColumnContents(BoxLayer* rootLayer, GraphicsContext& context, const Rect& rect, const Point& offset)
+void BoxLayer::paintLayerColumnContents(BoxLayer* rootLayer, const PaintInfo& info, const Point& offset)
 {
+    auto& context = info.context();
+    const auto& rect = info.rect();
     const auto& column = to<MultiColumnFlowBox>(*m_box);
     for(auto row = column.firstRow(); row; row = row->nextRow()) {
         auto clipRect = row->visualOverflowRect();
@@ -204,7 +209,7 @@ void BoxLayer::paintLayerColumnContents(BoxLayer* rootLayer, GraphicsContext& co
 
             context.save();
             context.translate(translation.x, translation.y);
-            paintLayerContents(this, context, rectangle, Point());
+            paintLayerContents(this, PaintInfo(context, rectangle, info.page()), Point());
             context.restore();
         }
 
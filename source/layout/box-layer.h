@@ -7,6 +7,7 @@
 
 namespace plutobook {
     class GraphicsContext;
+    class PaintInfo;
     class BoxModel;
     class BoxLayer;
 
@@ -43,14 +44,13 @@ namespace plutobook {
 
         void updateLayerPosition();
 
-        void paint(GraphicsContext& context, const Rect& rect);
-        void paintLayer(BoxLayer* rootLayer, GraphicsContext& context,
-                        const Rect& rect);
-        void paintLayerContents(BoxLayer* rootLayer, GraphicsContext& context,
-                                const Rect& rect, const Point& offset);
+        void paint(const PaintInfo& info);
+        void paintLayer(BoxLayer* rootLayer, const PaintInfo& info);
+        void paintLayerContents(BoxLayer* rootLayer, const PaintInfo& info,
+                                const Point& offset);
         void paintLayerColumnContents(BoxLayer* rootLayer,
-                                      GraphicsContext& context,
-                                      const Rect& rect, const Point& offset);
+                                      const PaintInfo& info,
+                                      const Point& offset);
 
     private:
         BoxLayer(BoxModel* box, BoxLayer* parent);
@@ -81,14 +81,14 @@ void CssPropertyMap::foreach(Fn fn) const {
     }
 }
 
+static bool isSameValue(const CssValuePtr& a, const CssValuePtr& b) {
+    return a == b || (a && b && a.isHeap() && b.isHeap() &&
+                      a.asHeap().isSame(b.asHeap()));
+}
+
 bool CssPropertyMap::operator==(const CssPropertyMap& other) const {
     return idSet() == other.idSet() &&
-           std::ranges::equal(m_values, other.m_values,
-                              [](const CssValuePtr& a, const CssValuePtr& b) {
-                                  return a == b ||
-                                         (a.isHeap() && b.isHeap() &&
-                                          a.asHeap().isSame(b.asHeap()));
-                              });
+           std::ranges::equal(m_values, other.m_values, isSameValue);
 }
 
 RefPtr<BoxStyle> BoxStyle::create(Node* node, PseudoType pseudoType, Display display)
@@ -3101,4 +3101,51 @@ bool isSame(const BoxStyle* a, const BoxStyle* b)
     return a->properties() == b->properties();
 }
 
+// Properties that are only read while painting. Changing one of them never
+// affects the box tree or its geometry.
+static bool isPaintOnlyProperty(CssPropertyID id)
+{
+    switch (id) {
+    case CssPropertyID::BackgroundColor:
+    case CssPropertyID::BorderTopColor:
+    case CssPropertyID::BorderRightColor:
+    case CssPropertyID::BorderBottomColor:
+    case CssPropertyID::BorderLeftColor:
+    case CssPropertyID::ColumnRuleColor:
+    case CssPropertyID::OutlineColor:
+    case CssPropertyID::TextDecorationColor:
+    case CssPropertyID::Color:
+    case CssPropertyID::Cursor:
+        return true;
+    default:
+        return false;
+    }
+}
+
+StyleDifference compareStyles(const BoxStyle* a, const BoxStyle* b)
+{
+    if (isSame(a, b))
+        return StyleDifference::None;
+    if (a == nullptr || b == nullptr)
+        return StyleDifference::Layout;
+    auto difference = StyleDifference::Paint;
+    if (a->customProperties() != b->customProperties())
+        difference = StyleDifference::InheritedPaint;
+    auto compare = [&](const BoxStyle* style, const BoxStyle* other) {
+        style->properties().foreach([&](CssPropertyID id, const CssValuePtr& value) {
+            if (difference == StyleDifference::Layout || isSameValue(value, other->get(id)))
+                return;
+            if (!isPaintOnlyProperty(id)) {
+                difference = StyleDifference::Layout;
+            } else if (id == CssPropertyID::Color || id == CssPropertyID::Cursor) {
+                difference = StyleDifference::InheritedPaint;
+            }
+        });
+    };
+
+    compare(a, b);
+    compare(b, a);
+    return difference;
+}
+
 } // namespace plutobook
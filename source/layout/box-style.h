@@ -959,6 +959,18 @@ namespace plutobook {
 
     bool isSame(const BoxStyle* a, const BoxStyle* b);
 
+    enum class StyleDifference : uint8_t {
+        None,
+        Paint,
+        InheritedPaint,
+        Layout
+    };
+
+    // Classifies how replacing style `a` with `b` affects the box tree:
+    // Paint differences can be applied to the existing boxes in place,
+    // InheritedPaint ones also have to reach the descendants.
+    StyleDifference compareStyles(const BoxStyle* a, const BoxStyle* b);
+
     inline bool BoxStyle::isDisplayBlockType(Display display) {
         switch (display) {
         case Display::Block:
@@ -1,5 +1,6 @@
 #include "box-view.h"
 #include "page-box.h"
+#include "table-box.h"
 #include "document.h"
 
 namespace plutobook {
@@ -9,17 +10,17 @@ BoxView::BoxView(Document* document, const RefPtr<BoxStyle>& style)
 {
 }
 
-Rect BoxView::backgroundRect() const
+Rect BoxView::backgroundRect(const PageBox* page) const
 {
-    if(m_currentPage)
-        return document()->pageContentRectAt(m_currentPage->pageIndex());
+    if(page)
+        return document()->pageContentRectAt(page->pageIndex());
     return Rect(0, 0, document()->width(), document()->height());
 }
 
 void BoxView::paintRootBackground(const PaintInfo& info) const
 {
     if(m_backgroundStyle) {
-        paintBackgroundStyle(info, backgroundRect(), m_backgroundStyle);
+        paintBackgroundStyle(info, backgroundRect(info.page()), m_backgroundStyle);
     }
 }
 
@@ -31,11 +32,83 @@ void BoxView::computeHeight(float& y, float& height, float& marginTop, float& ma
 {
 }
 
+static void buildPaintIndexes(Box* box)
+{
+    for(auto child = box->firstChild(); child; child = child->nextSibling())
+        buildPaintIndexes(child);
+    if(auto block = to<BlockBox>(box)) {
+        block->buildPaintIndex();
+    } else if(auto section = to<TableSectionBox>(box)) {
+        section->buildPaintIndex();
+    }
+}
+
 void BoxView::layout(FragmentBuilder* fragmentainer)
 {
+    document()->incrementLayoutCount();
     setWidth(document()->containerWidth());
     BlockFlowBox::layout(fragmentainer);
     updateLayerPosition();
+    buildPaintIndexes(this);
+}
+
+static bool isWithin(const Box* box, const Box* ancestor)
+{
+    while(box && box != ancestor)
+        box = box->parentBox();
+    return box == ancestor;
+}
+
+static bool hasEscapingPositionedBoxes(const Box* box, const Box* root)
+{
+    for(auto child = box->firstChild(); child; child = child->nextSibling()) {
+        if(child->isPositioned() && !isWithin(child->containingBlock(), root))
+            return true;
+        if(hasEscapingPositionedBoxes(child, root)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+BlockFlowBox* BoxView::findLayoutRoot(Box* box)
+{
+    // A root clips its overflow and has a fixed size, so laying it out again
+    // leaves its size, its margins and the overflow of its ancestors alone.
+    // It must be placed by normal block flow, outside any fragmented flow,
+    // and hold every positioned box below it.
+    for(; box && !box->isBoxView(); box = box->parentBox()) {
+        auto block = to<BlockFlowBox>(box);
+        if(block == nullptr || block->isInline() || block->isFloatingOrPositioned() || !block->isOverflowHidden()
+            || !block->parentBox()->isBlockFlowBox()
+            || !block->style()->width().isFixed() || !block->style()->height().isFixed()) {
+            continue;
+        }
+
+        auto parent = block->parentBox();
+        while(parent && !parent->isMultiColumnFlowBox())
+            parent = parent->parentBox();
+        if(parent == nullptr && !hasEscapingPositionedBoxes(block, block)) {
+            return block;
+        }
+    }
+
+    return nullptr;
+}
+
+bool BoxView::relayout(BlockFlowBox* root)
+{
+    const auto oldRect = root->borderBoundingBox();
+    root->layout(nullptr);
+    const auto newRect = root->borderBoundingBox();
+    if(!isNearlyEqual(oldRect.x, newRect.x) || !isNearlyEqual(oldRect.y, newRect.y)
+        || !isNearlyEqual(oldRect.w, newRect.w) || !isNearlyEqual(oldRect.h, newRect.h)) {
+        return false;
+    }
+
+    buildPaintIndexes(root);
+    return true;
 }
 
 void BoxView::build()
@@ -13,13 +13,10 @@ namespace plutobook {
 
         bool requiresLayer() const final { return true; }
         BoxStyle* backgroundStyle() const { return m_backgroundStyle; }
-        Rect backgroundRect() const;
+        Rect backgroundRect(const PageBox* page) const;
 
         void paintRootBackground(const PaintInfo& info) const final;
 
-        void setCurrentPage(PageBox* page) { m_currentPage = page; }
-        PageBox* currentPage() const { return m_currentPage; }
-
         void computeWidth(float& x, float& width, float& marginLeft,
                           float& marginRight) const final;
         void computeHeight(float& y, float& height, float& marginTop,
@@ -27,10 +24,18 @@ namespace plutobook {
         void layout(FragmentBuilder* fragmentainer) final;
         void build() final;
 
+        // Returns the nearest block at or above box that can be laid out
+        // again on its own, or nullptr if the whole view has to be.
+        static BlockFlowBox* findLayoutRoot(Box* box);
+
+        // Lays out a root found by findLayoutRoot() again. Returns false if
+        // its border box moved or changed size, in which case the view has
+        // to be laid out again. The layers are left for the caller to update.
+        bool relayout(BlockFlowBox* root);
+
         const char* name() const final { return "BoxView"; }
 
     private:
         BoxStyle* m_backgroundStyle{nullptr};
-        PageBox* m_currentPage{nullptr};
     };
 } // namespace plutobook
\ No newline at end of file
@@ -744,6 +744,7 @@ void BoxModel::paintBackgroundStyle(const PaintInfo& info, const Rect& borderRec
 
         destRect.intersect(borderRect);
         if(destRect.intersects(info.rect())) {
+            std::lock_guard guard(backgroundImage->paintMutex());
             backgroundImage->setContainerSize(tileRect.size());
             backgroundImage->drawTiled(*info, destRect, tileRect);
         }
@@ -779,9 +780,9 @@ void BoxModel::paint(const PaintInfo& info, const Point& offset, PaintPhase phas
     assert(false);
 }
 
-void BoxModel::paintLayer(GraphicsContext& context, const Rect& rect)
+void BoxModel::paintLayer(const PaintInfo& info)
 {
-    m_layer->paint(context, rect);
+    m_layer->paint(info);
 }
 
 void BoxModel::updateLayerPosition()
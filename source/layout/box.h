@@ -13,11 +13,13 @@ namespace plutobook {
 
     class GraphicsContext;
     class BoxFrame;
+    class PageBox;
 
     class PaintInfo {
     public:
-        PaintInfo(GraphicsContext& context, const Rect& rect)
-            : m_context(context), m_rect(rect) {}
+        PaintInfo(GraphicsContext& context, const Rect& rect,
+                  const PageBox* page = nullptr)
+            : m_context(context), m_rect(rect), m_page(page) {}
 
         GraphicsContext& operator*() const { return m_context; }
         GraphicsContext* operator->() const { return &m_context; }
@@ -25,11 +27,17 @@ namespace plutobook {
         GraphicsContext& context() const { return m_context; }
         const Rect& rect() const { return m_rect; }
 
+        // The page being painted, or null when painting the continuous
+        // document. Kept here rather than on the BoxView so that several
+        // pages can be painted concurrently from the same tree.
+        const PageBox* page() const { return m_page; }
+
         bool shouldPaintBox(const BoxFrame* box, const Point& offset) const;
 
     private:
         GraphicsContext& m_context;
         Rect m_rect;
+        const PageBox* m_page;
     };
 
     class Node;
@@ -101,6 +109,7 @@ namespace plutobook {
 
         Node* node() const { return m_node; }
         BoxStyle* style() const { return m_style.get(); }
+        void setStyle(const RefPtr<BoxStyle>& style) { m_style = style; }
         Box* parentBox() const { return m_parentBox; }
         Box* nextSibling() const { return m_nextSibling; }
         Box* prevSibling() const { return m_prevSibling; }
@@ -322,7 +331,7 @@ namespace plutobook {
 
         BoxLayer* layer() const { return m_layer.get(); }
 
-        void paintLayer(GraphicsContext& context, const Rect& rect);
+        void paintLayer(const PaintInfo& info);
         void updateLayerPosition();
 
         float relativePositionOffsetX() const;
@@ -4,6 +4,9 @@
 #include "inline-box.h"
 #include "block-box.h"
 #include "document.h"
+#include "string-utils.h"
+
+#include <unicode/locid.h>
 
 #include <ranges>
 
@@ -30,6 +33,49 @@ LineItemsBuilder::LineItemsBuilder(LineItemsData& data)
 {
 }
 
+// Turkish and Azeri map i and I to the dotted and dotless forms, so plain
+// ASCII case mapping only matches ICU's in the other locales.
+static bool hasAsciiCaseMapping(const icu::Locale& locale)
+{
+    std::string_view language(locale.getLanguage());
+    return language != "tr" && language != "az";
+}
+
+// Widens pure ASCII text straight into UTF-16, folding case on the way, so
+// that the common case skips the UTF-8 decoder and the ICU case mapping.
+// This only saves decoding time: line layout still holds its text as
+// UTF-16, two bytes per character, since bidi, line breaking and shaping
+// all index into that one buffer.
+static bool decodeAsciiText(const HeapString& data, TextTransform transform, UString& text)
+{
+    if(transform == TextTransform::Capitalize)
+        return false;
+    if(transform != TextTransform::None && !hasAsciiCaseMapping(icu::Locale::getDefault()))
+        return false;
+    for(auto cc : data) {
+        if(cc & 0x80) {
+            return false;
+        }
+    }
+
+    const auto characters = data.data();
+    const auto length = static_cast<int32_t>(data.size());
+    auto buffer = text.getBuffer(length);
+    for(int32_t index = 0; index < length; ++index) {
+        uint8_t cc = characters[index];
+        if(transform == TextTransform::Uppercase && isLower(cc)) {
+            cc -= kAsciiUpperToLower;
+        } else if(transform == TextTransform::Lowercase) {
+            cc = toLower(cc);
+        }
+
+        buffer[index] = cc;
+    }
+
+    text.releaseBuffer(length);
+    return true;
+}
+
 void LineItemsBuilder::appendText(Box* box, const HeapString& data)
 {
     if(box->isWordBreakBox()) {
@@ -37,7 +83,13 @@ void LineItemsBuilder::appendText(Box* box, const HeapString& data)
         return;
     }
 
-    auto text = UString::fromUTF8(icu::StringPiece(data.data(), data.size()));
+    UString text;
+    if(decodeAsciiText(data, box->style()->textTransform(), text)) {
+        appendText(box, text);
+        return;
+    }
+
+    text = UString::fromUTF8(icu::StringPiece(data.data(), data.size()));
     switch(box->style()->textTransform()) {
     case TextTransform::None:
         appendText(box, text);
@@ -1723,9 +1775,27 @@ void LineLayout::build()
     builder.exitBlock(m_block);
 }
 
+void LineLayout::buildPaintIndex()
+{
+    m_paintIndex.clear();
+    for(const auto& line : m_lines) {
+        auto overflowRect = line->visualOverflowRect();
+        m_paintIndex.add(line.get(), overflowRect.y, overflowRect.bottom());
+    }
+
+    m_paintIndex.build();
+}
+
 void LineLayout::paint(const PaintInfo& info, const Point& offset, PaintPhase phase)
 {
     if(phase == PaintPhase::Contents || phase == PaintPhase::Outlines) {
+        if(!m_paintIndex.isEmpty()) {
+            const auto& rect = info.rect();
+            for(auto line : m_paintIndex.query(rect.y - offset.y, rect.bottom() - offset.y))
+                line->paint(info, offset, phase);
+            return;
+        }
+
         for(const auto& line : m_lines) {
             line->paint(info, offset, phase);
         }
@@ -2,6 +2,7 @@
 
 #include "text-shape.h"
 #include "text-break-iterator.h"
+#include "paint-index.h"
 
 #include <unicode/ubidi.h>
 
@@ -387,6 +388,7 @@ namespace plutobook {
         void layout(FragmentBuilder* fragmentainer);
         void build();
 
+        void buildPaintIndex();
         void paint(const PaintInfo& info, const Point& offset,
                    PaintPhase phase);
         void serialize(OutputStream& o, int indent) const;
@@ -396,5 +398,6 @@ namespace plutobook {
         BlockFlowBox* m_block;
         RootLineBoxList m_lines;
         LineItemsData m_data;
+        PaintIndex<RootLineBox*> m_paintIndex;
     };
 } // namespace plutobook
\ No newline at end of file
@@ -438,7 +438,7 @@ void PageBox::paintContents(const PaintInfo& info, const Point& offset, PaintPha
         info->scale(m_pageScale, m_pageScale);
         info->translate(-contentRect.x, -contentRect.y);
         info->clipRect(contentRect);
-        document()->render(*info, contentRect);
+        document()->render(*info, contentRect, this);
         info->restore();
     }
 }
@@ -621,6 +621,8 @@ PageLayout::PageLayout(Document* document)
 {
 }
 
+PageLayout::~PageLayout() = default;
+
 constexpr PseudoType pagePseudoType(uint32_t pageIndex)
 {
     if(pageIndex == 0)
@@ -632,14 +634,10 @@ constexpr PseudoType pagePseudoType(uint32_t pageIndex)
 
 constexpr auto kMinPageScaleFactor = 1.f / 100.f;
 
-void PageLayout::layout()
+void PageLayout::layout(bool singlePass)
 {
-    auto& pages = m_document->pages();
-    if(!pages.empty()) {
-        const auto& pageBox = pages.front();
-        auto contentWidth = pageBox->width() - pageBox->padding(LeftEdge) - pageBox->padding(RightEdge);
-        auto contentHeight = pageBox->height() - pageBox->padding(TopEdge) - pageBox->padding(BottomEdge);
-        m_document->setContainerSize(contentWidth / pageBox->pageScale(), contentHeight / pageBox->pageScale());
+    if(m_pageCount > 0) {
+        m_document->setContainerSize(m_contentWidth / m_pageScaleFactor, m_contentHeight / m_pageScaleFactor);
         m_document->box()->layout(m_document);
         return;
     }
@@ -651,8 +649,8 @@ void PageLayout::layout()
     auto pageSize = pageStyle->getPageSize(context->pageSize());
     auto pageScale = pageStyle->pageScale();
 
-    auto pageWidth = pageStyle->width().calc(pageSize.width() / units::px);
-    auto pageHeight = pageStyle->height().calc(pageSize.height() / units::px);
+    m_pageWidth = pageStyle->width().calc(pageSize.width() / units::px);
+    m_pageHeight = pageStyle->height().calc(pageSize.height() / units::px);
 
     auto marginLeftLength = pageStyle->margin(LeftEdge);
     auto marginRightLength = pageStyle->margin(RightEdge);
@@ -660,65 +658,101 @@ void PageLayout::layout()
     auto marginBottomLength = pageStyle->margin(BottomEdge);
 
     const auto& deviceMargins = context->pageMargins();
-    auto marginTop = marginTopLength.isAuto() ? deviceMargins.top() / units::px : marginTopLength.calcMin(pageHeight);
-    auto marginRight = marginRightLength.isAuto() ? deviceMargins.right() / units::px : marginRightLength.calcMin(pageWidth);
-    auto marginBottom = marginBottomLength.isAuto() ? deviceMargins.bottom() / units::px : marginBottomLength.calcMin(pageHeight);
-    auto marginLeft = marginLeftLength.isAuto() ? deviceMargins.left() / units::px : marginLeftLength.calcMin(pageWidth);
-
-    auto paddingTop = pageStyle->padding(TopEdge).calcMin(pageHeight);
-    auto paddingRight = pageStyle->padding(RightEdge).calcMin(pageWidth);
-    auto paddingBottom = pageStyle->padding(BottomEdge).calcMin(pageHeight);
-    auto paddingLeft = pageStyle->padding(LeftEdge).calcMin(pageWidth);
-
-    auto width = std::max(0.f, pageWidth - marginLeft - marginRight);
-    auto height = std::max(0.f, pageHeight - marginTop - marginBottom);
-
-    auto contentWidth = std::max(0.f, width - paddingLeft - paddingRight);
-    auto contentHeight = std::max(0.f, height - paddingTop - paddingBottom);
-
-    auto pageScaleFactor = std::max(kMinPageScaleFactor, pageScale.value_or(1.f));
-    if (m_document->setContainerSize(contentWidth / pageScaleFactor, contentHeight / pageScaleFactor)) {
-        box->layout(m_document);
+    m_marginTop = marginTopLength.isAuto() ? deviceMargins.top() / units::px : marginTopLength.calcMin(m_pageHeight);
+    m_marginRight = marginRightLength.isAuto() ? deviceMargins.right() / units::px : marginRightLength.calcMin(m_pageWidth);
+    m_marginBottom = marginBottomLength.isAuto() ? deviceMargins.bottom() / units::px : marginBottomLength.calcMin(m_pageHeight);
+    m_marginLeft = marginLeftLength.isAuto() ? deviceMargins.left() / units::px : marginLeftLength.calcMin(m_pageWidth);
+
+    m_paddingTop = pageStyle->padding(TopEdge).calcMin(m_pageHeight);
+    m_paddingRight = pageStyle->padding(RightEdge).calcMin(m_pageWidth);
+    m_paddingBottom = pageStyle->padding(BottomEdge).calcMin(m_pageHeight);
+    m_paddingLeft = pageStyle->padding(LeftEdge).calcMin(m_pageWidth);
+
+    m_width = std::max(0.f, m_pageWidth - m_marginLeft - m_marginRight);
+    m_height = std::max(0.f, m_pageHeight - m_marginTop - m_marginBottom);
+
+    m_contentWidth = std::max(0.f, m_width - m_paddingLeft - m_paddingRight);
+    m_contentHeight = std::max(0.f, m_height - m_paddingTop - m_paddingBottom);
+
+    m_pageScaleFactor = std::max(kMinPageScaleFactor, pageScale.value_or(1.f));
+    if(!pageScale.has_value() && singlePass) {
+        // The document cannot be laid out narrower than its min-content
+        // width, so that width predicts the shrink-to-fit scale below.
+        auto minContentWidth = box->minPreferredWidth();
+        if(minContentWidth > m_contentWidth) {
+            m_pageScaleFactor = std::max(kMinPageScaleFactor, m_contentWidth / minContentWidth);
+        }
     }
 
+    // The boxes may still hold a continuous layout for a container of the
+    // same size, which is not fragmented, so they are always laid out here.
+    m_document->setContainerSize(m_contentWidth / m_pageScaleFactor, m_contentHeight / m_pageScaleFactor);
+    box->layout(m_document);
+
     if(!pageScale.has_value() && m_document->containerWidth() < m_document->width()) {
-        pageScaleFactor = std::max(kMinPageScaleFactor, m_document->containerWidth() / m_document->width());
-        if (m_document->setContainerSize(contentWidth / pageScaleFactor, contentHeight / pageScaleFactor)) {
+        m_pageScaleFactor = std::max(kMinPageScaleFactor, m_pageScaleFactor * m_document->containerWidth() / m_document->width());
+        if (m_document->setContainerSize(m_contentWidth / m_pageScaleFactor, m_contentHeight / m_pageScaleFactor)) {
             box->layout(m_document);
         }
     }
 
     if(m_document->containerHeight() > 0.f) {
-        Counters counters(m_document, std::ceil(m_document->height() / m_document->containerHeight()));
-        for(uint32_t pageIndex = 0; pageIndex < counters.pageCount(); ++pageIndex) {
-            if(pageIndex > 0) pageStyle = m_document->styleSheet().styleForPage(emptyGlo, pageIndex, pagePseudoType(pageIndex));
-            auto pageBox = PageBox::create(pageStyle, emptyGlo, pageIndex, pageWidth, pageHeight, pageScaleFactor);
+        m_pageCount = std::ceil(m_document->height() / m_document->containerHeight());
+        m_counters = std::make_unique<Counters>(m_document, m_pageCount);
+        m_firstPageStyle = std::move(pageStyle);
+        m_document->pages().resize(m_pageCount);
+    }
+}
 
-            pageBox->setX(marginLeft);
-            pageBox->setY(marginTop);
+PageSize PageLayout::pageSize() const
+{
+    return PageSize(m_pageWidth * units::px, m_pageHeight * units::px);
+}
 
-            pageBox->setWidth(width);
-            pageBox->setHeight(height);
+PageBox* PageLayout::pageAt(uint32_t pageIndex)
+{
+    auto& pages = m_document->pages();
+    if(pageIndex >= pages.size())
+        return nullptr;
+    // The page counters carry over from one page to the next, so the pages
+    // are built in order, each one the first time it or a later one is used.
+    while(m_nextPageIndex <= pageIndex) {
+        pages[m_nextPageIndex] = buildPage(m_nextPageIndex);
+        ++m_nextPageIndex;
+    }
 
-            pageBox->setMargin(TopEdge, marginTop);
-            pageBox->setMargin(RightEdge, marginRight);
-            pageBox->setMargin(BottomEdge, marginBottom);
-            pageBox->setMargin(LeftEdge, marginLeft);
+    return pages[pageIndex].get();
+}
 
-            pageBox->setPadding(TopEdge, paddingTop);
-            pageBox->setPadding(RightEdge, paddingRight);
-            pageBox->setPadding(BottomEdge, paddingBottom);
-            pageBox->setPadding(LeftEdge, paddingLeft);
+std::unique_ptr<PageBox> PageLayout::buildPage(uint32_t pageIndex)
+{
+    auto pageStyle = std::move(m_firstPageStyle);
+    if(pageIndex > 0)
+        pageStyle = m_document->styleSheet().styleForPage(emptyGlo, pageIndex, pagePseudoType(pageIndex));
+    auto pageBox = PageBox::create(pageStyle, emptyGlo, pageIndex, m_pageWidth, m_pageHeight, m_pageScaleFactor);
 
-            counters.update(pageBox.get());
-            buildPageMargins(counters, pageBox.get());
+    pageBox->setX(m_marginLeft);
+    pageBox->setY(m_marginTop);
 
-            pageBox->build();
-            pageBox->layout(nullptr);
+    pageBox->setWidth(m_width);
+    pageBox->setHeight(m_height);
 
-            pages.push_back(std::move(pageBox));
-        }
-    }
+    pageBox->setMargin(TopEdge, m_marginTop);
+    pageBox->setMargin(RightEdge, m_marginRight);
+    pageBox->setMargin(BottomEdge, m_marginBottom);
+    pageBox->setMargin(LeftEdge, m_marginLeft);
+
+    pageBox->setPadding(TopEdge, m_paddingTop);
+    pageBox->setPadding(RightEdge, m_paddingRight);
+    pageBox->setPadding(BottomEdge, m_paddingBottom);
+    pageBox->setPadding(LeftEdge, m_paddingLeft);
+
+    m_counters->update(pageBox.get());
+    buildPageMargins(*m_counters, pageBox.get());
+
+    pageBox->build();
+    pageBox->layout(nullptr);
+    return pageBox;
 }
 
 void PageLayout::buildPageMargin(const Counters& counters, PageBox* pageBox, PageMarginType marginType)
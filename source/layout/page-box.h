@@ -119,14 +119,43 @@ namespace plutobook {
     class PageLayout {
     public:
         explicit PageLayout(Document* document);
+        ~PageLayout();
 
-        void layout();
+        void layout(bool singlePass);
+
+        uint32_t pageCount() const { return m_pageCount; }
+        PageSize pageSize() const;
+        PageBox* pageAt(uint32_t pageIndex);
 
     private:
+        std::unique_ptr<PageBox> buildPage(uint32_t pageIndex);
         void buildPageMargin(const Counters& counters, PageBox* pageBox,
                              PageMarginType marginType);
         void buildPageMargins(const Counters& counters, PageBox* pageBox);
 
         Document* m_document;
+        std::unique_ptr<Counters> m_counters;
+        RefPtr<BoxStyle> m_firstPageStyle;
+        uint32_t m_pageCount{0};
+        uint32_t m_nextPageIndex{0};
+
+        float m_pageWidth{0};
+        float m_pageHeight{0};
+        float m_pageScaleFactor{1};
+
+        float m_width{0};
+        float m_height{0};
+        float m_contentWidth{0};
+        float m_contentHeight{0};
+
+        float m_marginTop{0};
+        float m_marginRight{0};
+        float m_marginBottom{0};
+        float m_marginLeft{0};
+
+        float m_paddingTop{0};
+        float m_paddingRight{0};
+        float m_paddingBottom{0};
+        float m_paddingLeft{0};
     };
 } // namespace plutobook
\ No newline at end of file
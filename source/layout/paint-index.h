@@ -0,0 +1,82 @@
+#pragma once
+
+#include <algorithm>
+#include <span>
+#include <vector>
+
+namespace plutobook {
+    // Indexes the children of a container by their vertical paint extent so
+    // that painting a rect only visits the children that may intersect it.
+    // The index is built once after layout and is only read while painting.
+    template<typename T>
+    class PaintIndex {
+    public:
+        // Containers with fewer children are walked linearly.
+        static constexpr size_t kMinItemCount = 16;
+
+        void clear();
+        void add(T item, float top, float bottom);
+        void build();
+
+        bool isEmpty() const { return m_items.empty(); }
+
+        // Returns, in the order they were added, the run of items that holds
+        // every item whose extent intersects the vertical range [top, bottom].
+        // Items out of order may put a few others in the run, which the
+        // callers cull when painting them.
+        std::span<const T> query(float top, float bottom) const;
+
+    private:
+        std::vector<T> m_items;
+        // Once built, the lowest top of each item and the ones after it, and
+        // the highest bottom of each item and the ones before it. Both are
+        // sorted, so the run is found by two binary searches.
+        std::vector<float> m_tops;
+        std::vector<float> m_bottoms;
+    };
+
+    template<typename T>
+    void PaintIndex<T>::clear()
+    {
+        m_items.clear();
+        m_tops.clear();
+        m_bottoms.clear();
+    }
+
+    template<typename T>
+    void PaintIndex<T>::add(T item, float top, float bottom)
+    {
+        m_items.push_back(item);
+        m_tops.push_back(top);
+        m_bottoms.push_back(bottom);
+    }
+
+    template<typename T>
+    void PaintIndex<T>::build()
+    {
+        if(m_items.size() < kMinItemCount) {
+            clear();
+            return;
+        }
+
+        for(size_t i = 1; i < m_bottoms.size(); ++i)
+            m_bottoms[i] = std::max(m_bottoms[i], m_bottoms[i - 1]);
+        for(size_t i = m_tops.size() - 1; i > 0; --i) {
+            m_tops[i - 1] = std::min(m_tops[i - 1], m_tops[i]);
+        }
+
+        m_items.shrink_to_fit();
+        m_tops.shrink_to_fit();
+        m_bottoms.shrink_to_fit();
+    }
+
+    template<typename T>
+    std::span<const T> PaintIndex<T>::query(float top, float bottom) const
+    {
+        auto first = std::lower_bound(m_bottoms.begin(), m_bottoms.end(), top) - m_bottoms.begin();
+        auto last = std::upper_bound(m_tops.begin(), m_tops.end(), bottom) - m_tops.begin();
+        if(first >= last)
+            return std::span<const T>();
+        return std::span<const T>(m_items.data() + first, last - first);
+    }
+} // namespace plutobook
@@ -477,8 +477,12 @@ void ImageBox::paintReplaced(const PaintInfo& info, const Point& offset)
         info->clipRoundedRect(clipRect);
     }
 
-    m_image->setContainerSize(objectRect.size());
-    m_image->draw(*info, objectRect, Rect(m_image->size()));
+    {
+        std::lock_guard guard(m_image->paintMutex());
+        m_image->setContainerSize(objectRect.size());
+        m_image->draw(*info, objectRect, Rect(m_image->size()));
+    }
+
     if(clipping) {
         info->restore();
     }
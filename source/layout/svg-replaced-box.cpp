@@ -182,6 +182,7 @@ void SvgImageBox::render(const SvgRenderState& state) const
 {
     if(m_image == nullptr || state.mode() != SvgRenderMode::Painting || style()->visibility() != Visibility::Visible)
         return;
+    std::lock_guard guard(m_image->paintMutex());
     Rect dstRect(fillBoundingBox());
     m_image->setContainerSize(dstRect.size());
 
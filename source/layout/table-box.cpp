@@ -514,7 +514,7 @@ void TableBox::paintContents(const PaintInfo& info, const Point& offset, PaintPh
     }
 
     auto shouldPaintCollapsedBorders = phase == PaintPhase::Decorations && !m_collapsedBorderEdges.empty() && isBorderCollapsed();
-    if (view()->currentPage()) {
+    if (info.page()) {
         if (auto footer = footerSection()) {
             const auto& rect = info.rect();
             if (rect.bottom() < offset.y + footer->y()) {
@@ -551,7 +551,7 @@ void TableBox::paintContents(const PaintInfo& info, const Point& offset, PaintPh
         }
     }
 
-    if (view()->currentPage()) {
+    if (info.page()) {
         if (auto header = headerSection()) {
             const auto& rect = info.rect();
             if (rect.y > offset.y + header->y()) {
@@ -1396,12 +1396,32 @@ void TableSectionBox::build()
     BoxFrame::build();
 }
 
+void TableSectionBox::buildPaintIndex()
+{
+    m_paintIndex.clear();
+    for (auto rowBox : m_rows) {
+        auto overflowRect = rowBox->visualOverflowRect();
+        overflowRect.translate(rowBox->location());
+        m_paintIndex.add(rowBox, overflowRect.y, overflowRect.bottom());
+    }
+
+    m_paintIndex.build();
+}
+
+std::span<TableRowBox* const> TableSectionBox::rowsToPaint(const PaintInfo& info, const Point& offset) const
+{
+    if (m_paintIndex.isEmpty())
+        return m_rows;
+    const auto& rect = info.rect();
+    return m_paintIndex.query(rect.y - offset.y, rect.bottom() - offset.y);
+}
+
 void TableSectionBox::paintCollapsedBorders(const PaintInfo& info, const Point& offset, const TableCollapsedBorderEdge& currentEdge) const
 {
     Point adjustedOffset(offset + location());
     if (!info.shouldPaintBox(this, adjustedOffset))
         return;
-    for (auto rowBox : m_rows | std::views::reverse) {
+    for (auto rowBox : rowsToPaint(info, adjustedOffset) | std::views::reverse) {
         Point rowOffset(adjustedOffset + rowBox->location());
         if (!info.shouldPaintBox(rowBox, rowOffset))
             continue;
@@ -1419,7 +1439,7 @@ void TableSectionBox::paint(const PaintInfo& info, const Point& offset, PaintPha
     Point adjustedOffset(offset + location());
     if (!info.shouldPaintBox(this, adjustedOffset))
         return;
-    for (auto rowBox : m_rows) {
+    for (auto rowBox : rowsToPaint(info, adjustedOffset)) {
         Point rowOffset(adjustedOffset + rowBox->location());
         if (!info.shouldPaintBox(rowBox, rowOffset))
             continue;
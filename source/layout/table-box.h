@@ -184,6 +184,7 @@ namespace plutobook {
         void layout(FragmentBuilder* fragmentainer) final;
         void build() final;
 
+        void buildPaintIndex();
         void paintCollapsedBorders(
             const PaintInfo& info, const Point& offset,
             const TableCollapsedBorderEdge& currentEdge) const;
@@ -193,8 +194,11 @@ namespace plutobook {
         const char* name() const final { return "TableSectionBox"; }
 
     private:
+        std::span<TableRowBox* const> rowsToPaint(const PaintInfo& info, const Point& offset) const;
+
         TableRowBoxList m_rows;
         TableCellBoxList m_spanningCells;
+        PaintIndex<TableRowBox*> m_paintIndex;
     };
 
     inline TableBox* TableSectionBox::table() const {
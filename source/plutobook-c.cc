@@ -688,6 +688,56 @@ bool plutobook_write_to_pdf_stream(const plutobook_t* book, plutobook_stream_wri
     return plutobook_write_to_pdf_stream_range(book, callback, closure, PLUTOBOOK_MIN_PAGE_COUNT, PLUTOBOOK_MAX_PAGE_COUNT, 1);
 }
 
+bool plutobook_stream_to_pdf(const plutobook_t* book, plutobook_stream_write_callback_t callback, void* closure)
+{
+    return plutobook_stream_to_pdf_range(book, callback, closure, PLUTOBOOK_MIN_PAGE_COUNT, PLUTOBOOK_MAX_PAGE_COUNT, 1);
+}
+
+bool plutobook_stream_to_pdf_range(const plutobook_t* book, plutobook_stream_write_callback_t callback, void* closure, unsigned int page_start, unsigned int page_end, int page_step)
+{
+    return book->streamToPdf(callback, closure, page_start, page_end, page_step);
+}
+
+size_t plutobook_get_peak_memory_usage(void)
+{
+    return plutobook::peakMemoryUsage();
+}
+
+unsigned int plutobook_get_font_cache_hit_count(void)
+{
+    return plutobook::fontCacheHitCount();
+}
+
+unsigned int plutobook_get_font_cache_miss_count(void)
+{
+    return plutobook::fontCacheMissCount();
+}
+
+void plutobook_set_resource_cache_capacity(size_t capacity)
+{
+    plutobook::setResourceCacheCapacity(capacity);
+}
+
+size_t plutobook_get_resource_cache_capacity(void)
+{
+    return plutobook::resourceCacheCapacity();
+}
+
+size_t plutobook_get_resource_cache_size(void)
+{
+    return plutobook::resourceCacheSize();
+}
+
+unsigned int plutobook_get_resource_cache_hit_count(void)
+{
+    return plutobook::resourceCacheHitCount();
+}
+
+unsigned int plutobook_get_resource_cache_miss_count(void)
+{
+    return plutobook::resourceCacheMissCount();
+}
+
 bool plutobook_write_to_pdf_stream_range(const plutobook_t* book, plutobook_stream_write_callback_t callback, void* closure, unsigned int page_start, unsigned int page_end, int page_step)
 {
     return book->writeToPdf(callback, closure, page_start, page_end, page_step);
@@ -703,6 +753,66 @@ bool plutobook_write_to_png_stream(const plutobook_t* book, plutobook_stream_wri
     return book->writeToPng(callback, closure, width, height);
 }
 
+void plutobook_set_render_thread_count(plutobook_t* book, unsigned int count)
+{
+    book->setRenderThreadCount(count);
+}
+
+unsigned int plutobook_get_render_thread_count(const plutobook_t* book)
+{
+    return book->renderThreadCount();
+}
+
+void plutobook_set_single_pass_pagination(plutobook_t* book, bool enable)
+{
+    book->setSinglePassPagination(enable);
+}
+
+bool plutobook_get_single_pass_pagination(const plutobook_t* book)
+{
+    return book->singlePassPagination();
+}
+
+unsigned int plutobook_get_layout_count(const plutobook_t* book)
+{
+    return book->layoutCount();
+}
+
+unsigned int plutobook_get_style_cache_hit_count(const plutobook_t* book)
+{
+    return book->styleCacheHitCount();
+}
+
+unsigned int plutobook_get_style_cache_miss_count(const plutobook_t* book)
+{
+    return book->styleCacheMissCount();
+}
+
+unsigned int plutobook_get_shape_cache_hit_count(const plutobook_t* book)
+{
+    return book->shapeCacheHitCount();
+}
+
+unsigned int plutobook_get_shape_cache_miss_count(const plutobook_t* book)
+{
+    return book->shapeCacheMissCount();
+}
+
+unsigned long long plutobook_get_shaping_allocation_count(const plutobook_t* book)
+{
+    return book->shapingAllocationCount();
+}
+
+unsigned long long plutobook_get_glyph_run_draw_count(const plutobook_t* book)
+{
+    return book->glyphRunDrawCount();
+}
+
+unsigned long long plutobook_get_glyph_draw_count(const plutobook_t* book)
+{
+    return book->glyphDrawCount();
+}
+
 void plutobook_set_custom_resource_fetcher(plutobook_t* book, plutobook_resource_fetch_callback_t callback, void* closure)
 {
     book->setCustomResourceFetcher(book);
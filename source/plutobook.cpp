@@ -6,11 +6,25 @@
 #include "font-resource.h"
 #include "replaced-box.h"
 #include "graphics-context.h"
+#include "display-list.h"
 #include "output-stream.h"
+#include "thread-pool.h"
 
+#include <cairo/cairo.h>
+
+#include <algorithm>
 #include <cmath>
 #include <utility>
 #include <cstdio>
+#include <memory>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
 
 namespace plutobook {
 
@@ -55,6 +69,67 @@ static plutobook_stream_status_t stream_write_func(void* closure, const char* da
     return PLUTOBOOK_STREAM_STATUS_WRITE_ERROR;
 }
 
+static unsigned resolveThreadCount(unsigned count)
+{
+    if(count == 0)
+        count = std::thread::hardware_concurrency();
+    return std::max(1u, count);
+}
+
+size_t peakMemoryUsage()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) == -1)
+        return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return usage.ru_maxrss * size_t(1024);
+#endif
+#endif
+}
+
+uint32_t fontCacheHitCount()
+{
+    return FontDataCache::instance()->hitCount();
+}
+
+uint32_t fontCacheMissCount()
+{
+    return FontDataCache::instance()->missCount();
+}
+
+void setResourceCacheCapacity(size_t capacity)
+{
+    ResourceCache::instance()->setCapacity(capacity);
+}
+
+size_t resourceCacheCapacity()
+{
+    return ResourceCache::instance()->capacity();
+}
+
+size_t resourceCacheSize()
+{
+    return ResourceCache::instance()->size();
+}
+
+uint32_t resourceCacheHitCount()
+{
+    return ResourceCache::instance()->hitCount();
+}
+
+uint32_t resourceCacheMissCount()
+{
+    return ResourceCache::instance()->missCount();
+}
+
 Canvas::~Canvas()
 {
     plutobook_canvas_destroy(m_canvas);
@@ -326,16 +401,68 @@ float Book::viewportHeight() const
 
 float Book::documentWidth() const
 {
-    if(auto document = layoutIfNeeded())
-        return document->width();
-    return 0.f;
+    if(m_needsLayout)
+        layoutIfNeeded();
+    return m_documentWidth;
 }
 
 float Book::documentHeight() const
 {
-    if(auto document = layoutIfNeeded())
-        return document->height();
-    return 0.f;
+    if(m_needsLayout)
+        layoutIfNeeded();
+    return m_documentHeight;
+}
+
+uint32_t Book::layoutCount() const
+{
+    if(auto document = m_document.get())
+        return document->layoutCount();
+    return 0;
+}
+
+uint32_t Book::styleCacheHitCount() const
+{
+    if(auto document = m_document.get())
+        return document->styleSheet().matchedPropertiesCache().hitCount();
+    return 0;
+}
+
+uint32_t Book::styleCacheMissCount() const
+{
+    if(auto document = m_document.get())
+        return document->styleSheet().matchedPropertiesCache().missCount();
+    return 0;
+}
+
+uint32_t Book::shapeCacheHitCount() const
+{
+    if(auto document = m_document.get())
+        return document->textShapeCache().hitCount();
+    return 0;
+}
+
+uint32_t Book::shapeCacheMissCount() const
+{
+    if(auto document = m_document.get())
+        return document->textShapeCache().missCount();
+    return 0;
+}
+
+uint64_t Book::shapingAllocationCount() const
+{
+    if(auto document = m_document.get())
+        return document->textShapeCache().allocationCount();
+    return 0;
+}
+
+uint64_t Book::glyphRunDrawCount() const
+{
+    return m_glyphRunDrawCount;
+}
+
+uint64_t Book::glyphDrawCount() const
+{
+    return m_glyphDrawCount;
 }
 
 uint32_t Book::pageCount() const
@@ -435,10 +562,27 @@ bool Book::loadHtml(std::string_view content, std::string_view userStyle, std::s
 
 void Book::clearContent()
 {
+    // The display lists refer to the fonts and images of the document.
+    m_pageDisplayLists.clear();
+    m_documentDisplayList.reset();
     m_document.reset();
+    m_glyphRunDrawCount = 0;
+    m_glyphDrawCount = 0;
     m_needsBuild = true;
     m_needsLayout = true;
     m_needsPagination = true;
+    m_hasPageLayout = false;
+    m_documentWidth = 0.f;
+    m_documentHeight = 0.f;
+}
+
+void Book::invalidateLayout()
+{
+    m_needsLayout = true;
+    m_needsPagination = true;
+    m_hasPageLayout = false;
+    m_pageDisplayLists.clear();
+    m_documentDisplayList.reset();
 }
 
 void Book::renderPage(Canvas& canvas, uint32_t pageIndex) const
@@ -457,9 +601,10 @@ void Book::renderPage(plutobook_canvas_t* canvas, uint32_t pageIndex) const
 
 void Book::renderPage(cairo_t* canvas, uint32_t pageIndex) const
 {
-    if(auto document = paginateIfNeeded()) {
+    if(auto displayList = pageDisplayList(pageIndex)) {
         CairoGraphicsContext context(canvas);
-        document->renderPage(context, pageIndex);
+        displayList->replay(context);
+        addGlyphDrawCounts(context);
     }
 }
 
@@ -493,9 +638,10 @@ void Book::renderDocument(plutobook_canvas_t* canvas, float x, float y, float wi
 
 void Book::renderDocument(cairo_t* canvas) const
 {
-    if(auto document = layoutIfNeeded()) {
+    if(auto displayList = documentDisplayList()) {
         CairoGraphicsContext context(canvas);
-        document->render(context, Rect::Infinite);
+        displayList->replay(context);
+        addGlyphDrawCounts(context);
     }
 }
 
@@ -504,18 +650,22 @@ void Book::renderDocument(cairo_t* canvas, float x, float y, float width, float
     if(auto document = layoutIfNeeded()) {
         CairoGraphicsContext context(canvas);
         document->render(context, Rect(x, y, width, height));
+        addGlyphDrawCounts(context);
     }
 }
 
 void Book::build()
 {
     m_document->build();
+    invalidateLayout();
+    m_needsBuild = false;
 }
 
 void Book::layout(float width, float height)
 {
     m_document->setContainerSize(width, height);
     m_document->layout();
+    invalidateLayout();
 }
 
 void Book::renderDocument(GraphicsContext& context, float x, float y,
@@ -567,13 +717,41 @@ bool Book::writeToPdf(plutobook_stream_write_callback_t callback, void* closure,
     if(canvas.isNull())
         return false;
     canvas.scale(PLUTOBOOK_UNITS_PX, PLUTOBOOK_UNITS_PX);
-    canvas.setTitle(document()->title());
-    canvas.setSubject(m_subject);
-    canvas.setAuthor(m_author);
-    canvas.setCreator("PlutoBook " PLUTOBOOK_VERSION_STRING " (https://github.com/plutoprint)");
-    canvas.setKeywords(m_keywords);
-    canvas.setCreationDate(m_creationDate);
-    canvas.setModificationDate(m_modificationDate);
+    setDocumentInfo(canvas);
+
+    const auto threadCount = resolveThreadCount(m_renderThreadCount);
+    const auto document = paginateIfNeeded();
+    if(threadCount == 1 || document == nullptr || document->pageCount() == 0) {
+        for(auto pageNum = pageStart; pageStep > 0 ? pageNum <= pageEnd : pageNum >= pageEnd; pageNum += pageStep) {
+            canvas.setPageSize(pageSizeAt(pageNum - 1));
+            renderPage(canvas, pageNum - 1);
+            canvas.showPage();
+        }
+
+        canvas.finish();
+        return true;
+    }
+
+    // Record the pages that are not cached yet on the worker threads, then
+    // replay every page into the PDF in order.
+    std::vector<uint32_t> pageIndices;
+    for(auto pageNum = pageStart; pageStep > 0 ? pageNum <= pageEnd : pageNum >= pageEnd; pageNum += pageStep) {
+        if(m_pageDisplayLists[pageNum - 1] == nullptr) {
+            pageIndices.push_back(pageNum - 1);
+        }
+    }
+
+    if(!pageIndices.empty()) {
+        pageLayoutIfNeeded();
+        // Page boxes are built lazily and in order, which must not race.
+        document->pageAt(*std::max_element(pageIndices.begin(), pageIndices.end()));
+        parallelFor(pageIndices.size(), threadCount, [&](size_t index) {
+            auto displayList = std::make_unique<DisplayList>();
+            document->renderPage(*displayList, pageIndices[index]);
+            m_pageDisplayLists[pageIndices[index]] = std::move(displayList);
+        });
+    }
+
     for(auto pageNum = pageStart; pageStep > 0 ? pageNum <= pageEnd : pageNum >= pageEnd; pageNum += pageStep) {
         canvas.setPageSize(pageSizeAt(pageNum - 1));
         renderPage(canvas, pageNum - 1);
@@ -584,6 +762,109 @@ bool Book::writeToPdf(plutobook_stream_write_callback_t callback, void* closure,
     return true;
 }
 
+bool Book::streamToPdf(const std::string& filename, uint32_t pageStart, uint32_t pageEnd, int pageStep) const
+{
+    FileOutputStream output(filename);
+    if(!output.isOpen())
+        return false;
+    if(streamToPdf(output, pageStart, pageEnd, pageStep)) {
+        return true;
+    }
+
+    plutobook_set_error_message("Unable to write PDF '%s': %s", filename.data(), plutobook_get_error_message());
+    return false;
+}
+
+bool Book::streamToPdf(OutputStream& output, uint32_t pageStart, uint32_t pageEnd, int pageStep) const
+{
+    return streamToPdf(stream_write_func, &output, pageStart, pageEnd, pageStep);
+}
+
+bool Book::streamToPdf(plutobook_stream_write_callback_t callback, void* closure, uint32_t pageStart, uint32_t pageEnd, int pageStep) const
+{
+    // Page boxes are built in order and freed once written, so a page can
+    // not be revisited after a later one.
+    if(pageStep <= 0) {
+        plutobook_set_error_message("invalid page range: streaming requires a positive step");
+        return false;
+    }
+
+    auto document = pageLayoutIfNeeded();
+    if(document == nullptr || document->pageCount() == 0) {
+        plutobook_set_error_message("invalid document: no pages to write");
+        return false;
+    }
+
+    pageStart = std::max(1u, std::min(pageStart, document->pageCount()));
+    pageEnd = std::max(1u, std::min(pageEnd, document->pageCount()));
+    if(pageStart > pageEnd) {
+        plutobook_set_error_message("invalid page range: step direction does not match range (from=%u to=%u step=%d)", pageStart, pageEnd, pageStep);
+        return false;
+    }
+
+    PDFCanvas canvas(callback, closure, document->pageSizeAt(pageStart - 1));
+    if(canvas.isNull())
+        return false;
+    canvas.scale(PLUTOBOOK_UNITS_PX, PLUTOBOOK_UNITS_PX);
+    setDocumentInfo(canvas);
+
+    // The pages are recorded in batches of one page per render thread, so
+    // that their glyph runs get merged, and then replayed in order into the
+    // PDF surface, which writes the content stream of each page out when
+    // the page is shown. The page boxes up to the end of each batch are
+    // freed before the next one is built.
+    const auto threadCount = resolveThreadCount(m_renderThreadCount);
+    std::vector<uint32_t> pageIndices;
+    std::vector<std::unique_ptr<DisplayList>> displayLists;
+    uint32_t releaseIndex = 0;
+    m_pageDisplayLists.clear();
+    for(auto pageNum = pageStart; pageNum <= pageEnd;) {
+        pageIndices.clear();
+        for(; pageNum <= pageEnd && pageIndices.size() < threadCount; pageNum += pageStep)
+            pageIndices.push_back(pageNum - 1);
+        // Page boxes are built lazily and in order, which must not race.
+        document->pageAt(pageIndices.back());
+        displayLists.clear();
+        displayLists.resize(pageIndices.size());
+        parallelFor(pageIndices.size(), threadCount, [&](size_t index) {
+            auto displayList = std::make_unique<DisplayList>();
+            document->renderPage(*displayList, pageIndices[index]);
+            displayLists[index] = std::move(displayList);
+        });
+
+        for(size_t index = 0; index < pageIndices.size(); ++index) {
+            canvas.setPageSize(document->pageSizeAt(pageIndices[index]));
+            {
+                CairoGraphicsContext context(canvas.context());
+                displayLists[index]->replay(context);
+                addGlyphDrawCounts(context);
+            }
+
+            canvas.showPage();
+        }
+
+        for(; releaseIndex <= pageIndices.back(); ++releaseIndex) {
+            document->releasePage(releaseIndex);
+        }
+    }
+
+    canvas.finish();
+    document->clearPages();
+    m_needsPagination = true;
+    return true;
+}
+
+void Book::setDocumentInfo(PDFCanvas& canvas) const
+{
+    canvas.setTitle(document()->title());
+    canvas.setSubject(m_subject);
+    canvas.setAuthor(m_author);
+    canvas.setCreator("PlutoBook " PLUTOBOOK_VERSION_STRING " (https://github.com/plutoprint)");
+    canvas.setKeywords(m_keywords);
+    canvas.setCreationDate(m_creationDate);
+    canvas.setModificationDate(m_modificationDate);
+}
+
 bool Book::writeToPng(const std::string& filename, int width, int height) const
 {
     FileOutputStream output(filename);
@@ -626,11 +907,100 @@ bool Book::writeToPng(plutobook_stream_write_callback_t callback, void* closure,
     ImageCanvas canvas(width, height, ImageFormat::ARGB32);
     if(canvas.isNull())
         return false;
-    canvas.scale(xScale, yScale);
-    renderDocument(canvas, 0, 0, docWidth, docHeight);
+    const auto threadCount = resolveThreadCount(m_renderThreadCount);
+    if(threadCount == 1 || height < 2) {
+        // This replays the cached document display list, so a PNG written
+        // after a PDF does not lay the document out continuously again.
+        canvas.scale(xScale, yScale);
+        renderDocument(canvas);
+        return canvas.writeToPng(callback, closure);
+    }
+
+    const auto displayList = documentDisplayList();
+
+    // Each thread replays the display list into a horizontal band of the
+    // image on its own surface, skipping the items that fall outside the
+    // band; the bands are then copied into the canvas.
+    const auto bandCount = std::min<unsigned>(threadCount, height);
+    const auto bandHeight = static_cast<int>((height + bandCount - 1) / bandCount);
+    std::vector<cairo_surface_t*> bands(bandCount);
+    std::vector<uint64_t> bandGlyphRunCounts(bandCount);
+    std::vector<uint64_t> bandGlyphCounts(bandCount);
+    parallelFor(bandCount, threadCount, [&](size_t index) {
+        const auto bandY = static_cast<int>(index) * bandHeight;
+        const auto bandSize = std::max(0, std::min(bandHeight, height - bandY));
+        auto surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, bandSize);
+        auto bandCanvas = cairo_create(surface);
+        cairo_rectangle(bandCanvas, 0, 0, width, bandSize);
+        cairo_clip(bandCanvas);
+        cairo_translate(bandCanvas, 0, -bandY);
+        cairo_scale(bandCanvas, xScale, yScale);
+
+        // Antialiased edges may bleed one pixel past the item bounds.
+        Rect bandRect(0, bandY - 1, width, bandSize + 2);
+        bandRect.scale(1.f / xScale, 1.f / yScale);
+        CairoGraphicsContext context(bandCanvas);
+        displayList->replay(context, bandRect);
+        cairo_destroy(bandCanvas);
+        bands[index] = surface;
+        bandGlyphRunCounts[index] = context.glyphRunCount();
+        bandGlyphCounts[index] = context.glyphCount();
+    });
+
+    for(size_t index = 0; index < bandCount; ++index) {
+        m_glyphRunDrawCount += bandGlyphRunCounts[index];
+        m_glyphDrawCount += bandGlyphCounts[index];
+    }
+
+    auto context = canvas.context();
+    cairo_save(context);
+    cairo_set_operator(context, CAIRO_OPERATOR_SOURCE);
+    for(size_t index = 0; index < bands.size(); ++index) {
+        const auto bandY = static_cast<int>(index) * bandHeight;
+        cairo_set_source_surface(context, bands[index], 0, bandY);
+        cairo_rectangle(context, 0, bandY, width, cairo_image_surface_get_height(bands[index]));
+        cairo_fill(context);
+        cairo_surface_destroy(bands[index]);
+    }
+
+    cairo_restore(context);
     return canvas.writeToPng(callback, closure);
 }
 
+const DisplayList* Book::pageDisplayList(uint32_t pageIndex) const
+{
+    auto document = paginateIfNeeded();
+    if(document == nullptr || pageIndex >= document->pageCount())
+        return nullptr;
+    auto& displayList = m_pageDisplayLists[pageIndex];
+    if(displayList == nullptr) {
+        pageLayoutIfNeeded();
+        displayList = std::make_unique<DisplayList>();
+        document->renderPage(*displayList, pageIndex);
+    }
+
+    return displayList.get();
+}
+
+const DisplayList* Book::documentDisplayList() const
+{
+    if(m_documentDisplayList == nullptr) {
+        auto document = layoutIfNeeded();
+        if(document == nullptr)
+            return nullptr;
+        m_documentDisplayList = std::make_unique<DisplayList>();
+        document->render(*m_documentDisplayList, Rect::Infinite);
+    }
+
+    return m_documentDisplayList.get();
+}
+
+void Book::addGlyphDrawCounts(const CairoGraphicsContext& context) const
+{
+    m_glyphRunDrawCount += context.glyphRunCount();
+    m_glyphDrawCount += context.glyphCount();
+}
+
 Document* Book::buildIfNeeded() const
 {
     auto document = m_document.get();
@@ -645,11 +1015,17 @@ Document* Book::buildIfNeeded() const
 Document* Book::layoutIfNeeded() const
 {
     auto document = buildIfNeeded();
-    if(document && m_needsLayout) {
+    if(document && (m_needsLayout || m_hasPageLayout)) {
         document->setContainerSize(viewportWidth(), viewportHeight());
         document->layout();
-        m_needsPagination = true;
-        m_needsLayout = false;
+        if(m_needsLayout) {
+            m_documentWidth = document->width();
+            m_documentHeight = document->height();
+            m_documentDisplayList.reset();
+            m_needsLayout = false;
+        }
+
+        m_hasPageLayout = false;
     }
 
     return document;
@@ -659,9 +1035,24 @@ Document* Book::paginateIfNeeded() const
 {
     auto document = buildIfNeeded();
     if(document && m_needsPagination) {
-        document->paginate();
+        document->paginate(m_singlePassPagination);
+        m_pageDisplayLists.clear();
+        m_pageDisplayLists.resize(document->pageCount());
         m_needsPagination = false;
-        m_needsLayout = true;
+        m_hasPageLayout = true;
+    }
+
+    return document;
+}
+
+Document* Book::pageLayoutIfNeeded() const
+{
+    // The page boxes survive a continuous layout, so only the document
+    // boxes have to be fragmented again before another page is painted.
+    auto document = paginateIfNeeded();
+    if(document && !m_hasPageLayout) {
+        document->paginate(m_singlePassPagination);
+        m_hasPageLayout = true;
     }
 
     return document;
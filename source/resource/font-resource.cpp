@@ -7,6 +7,7 @@
 
 #include <fontconfig/fontconfig.h>
 #include <harfbuzz/hb.h>
+#include <unicode/uchar.h>
 
 #include <numbers>
 #include <cmath>
@@ -37,10 +38,14 @@ hb_face_t* createHBFaceFromResource(ResourceData resource)
 
 RefPtr<FontResource> FontResource::create(Document* document, const Url& url)
 {
-    auto resource = ResourceLoader::loadUrl(url, document->customResourceFetcher());
+    return create(document, url, ResourceLoader::loadUrl(url, document->customResourceFetcher()));
+}
+
+RefPtr<FontResource> FontResource::create(Document* document, const Url& url, const ResourceData& resource)
+{
     if(resource.isNull())
         return nullptr;
-    auto face = graphicsManager().createFaceFromResource(std::move(resource));
+    auto face = graphicsManager().createFaceFromResource(resource);
     if(face == FaceHandle::Invalid) {
         plutobook_set_error_message("Unable to load font '%s': %s", url.value().data(), plutobook_get_error_message());
         return nullptr;
@@ -560,15 +565,61 @@ static RefPtr<SimpleFontData> createFontData(FcConfig* config, GlobalString fami
 RefPtr<SimpleFontData> FontDataCache::getFontData(GlobalString family, const FontDataDescription& description)
 {
     std::lock_guard guard(m_mutex);
-    auto [it, inserted] = m_table.try_emplace(FontDataKey(family, description));
-    if(inserted)
-        it->second = createFontData(m_config, family, description);
-    return it->second;
+    FontDataKey key(family, description);
+    auto it = m_table.find(key);
+    if(it != m_table.end()) {
+        ++m_hitCount;
+        return it->second;
+    }
+
+    ++m_missCount;
+    if(m_table.size() >= kMaxFontDataCount)
+        m_table.clear();
+    auto fontData = createFontData(m_config, family, description);
+    m_table.emplace(std::move(key), fontData);
+    return fontData;
 }
 
 RefPtr<SimpleFontData> FontDataCache::getFontData(uint32_t codepoint, uint32_t variationSelector, const FontDataDescription& description)
 {
     std::lock_guard guard(m_mutex);
+    const auto color = variationSelector == kEmojiVariationSelector;
+    FallbackKey fallbackKey(ublock_getCode(codepoint), color, description);
+    auto it = m_fallbackTable.find(fallbackKey);
+    if(it == m_fallbackTable.end()) {
+        if(m_fallbackTable.size() >= kMaxFallbackCount)
+            m_fallbackTable.clear();
+        it = m_fallbackTable.emplace(std::move(fallbackKey), FallbackFontList()).first;
+    }
+
+    auto& fonts = it->second;
+    for(const auto& font : fonts) {
+        if(graphicsManager().hasCodepoint(font->font(), codepoint)) {
+            ++m_hitCount;
+            return font;
+        }
+    }
+
+    MissingKey missingKey(codepoint, color, description);
+    if(m_missingTable.contains(missingKey)) {
+        ++m_hitCount;
+        return nullptr;
+    }
+
+    ++m_missCount;
+    if(auto fontData = matchFontData(codepoint, color, description)) {
+        fonts.push_back(fontData);
+        return fontData;
+    }
+
+    if(m_missingTable.size() >= kMaxMissingCount)
+        m_missingTable.clear();
+    m_missingTable.insert(std::move(missingKey));
+    return nullptr;
+}
+
+RefPtr<SimpleFontData> FontDataCache::matchFontData(uint32_t codepoint, bool color, const FontDataDescription& description)
+{
     auto pattern = FcPatternCreate();
     auto charSet = FcCharSetCreate();
 
@@ -579,7 +630,7 @@ RefPtr<SimpleFontData> FontDataCache::getFontData(uint32_t codepoint, uint32_t v
     FcPatternAddInteger(pattern, FC_WIDTH, fcWidth(description.request.width));
     FcPatternAddInteger(pattern, FC_SLANT, fcSlant(description.request.slope));
     FcPatternAddBool(pattern, FC_SCALABLE, FcTrue);
-    if (variationSelector == kEmojiVariationSelector) {
+    if(color) {
         FcPatternAddBool(pattern, FC_COLOR, FcTrue);
     }
 
@@ -632,6 +683,12 @@ bool FontDataCache::isFamilyAvailable(GlobalString family)
     return false;
 }
 
+FontDataCache* FontDataCache::instance()
+{
+    static FontDataCache cache;
+    return &cache;
+}
+
 FontDataCache::~FontDataCache()
 {
     FcConfigDestroy(m_config);
@@ -648,6 +705,39 @@ RefPtr<Font> Font::create(Document* document, const FontDescription& description
 }
 
 const SimpleFontData* Font::getFontData(uint32_t codepoint, uint32_t variationSelector)
+{
+    if(variationSelector == 0 && codepoint < 0x10000) {
+        if(m_codepointCache == nullptr)
+            m_codepointCache = std::make_unique<CodepointCache>();
+        auto& entry = (*m_codepointCache)[codepoint % kCodepointCacheSize];
+        if(entry.codepoint != codepoint) {
+            auto fontData = findFontData(codepoint, variationSelector);
+            entry.codepoint = codepoint;
+            entry.fontData = fontData;
+        }
+
+        return entry.fontData;
+    }
+
+    const auto key = uint64_t(codepoint) << 32 | variationSelector;
+    auto it = m_codepointOverflow.find(key);
+    if(it != m_codepointOverflow.end())
+        return it->second;
+    auto fontData = findFontData(codepoint, variationSelector);
+    if(m_codepointOverflow.size() >= kMaxCodepointOverflowCount)
+        m_codepointOverflow.clear();
+    m_codepointOverflow.emplace(key, fontData);
+    return fontData;
+}
+
+void Font::clearCodepointCache()
+{
+    if(m_codepointCache)
+        m_codepointCache->fill(CodepointCacheEntry());
+    m_codepointOverflow.clear();
+}
+
+const SimpleFontData* Font::findFontData(uint32_t codepoint, uint32_t variationSelector)
 {
     for (const auto& font : m_fonts) {
         if (auto fontData = font->getFontData(codepoint, variationSelector)) {
@@ -661,6 +751,7 @@ const SimpleFontData* Font::getFontData(uint32_t codepoint, uint32_t variationSe
             if(auto fontData = m_document->fontDataCache()->getFontData(emoji, m_description.data)) {
                 m_emojiFont = fontData.get();
                 m_fonts.push_back(std::move(fontData));
+                clearCodepointCache();
             }
         }
 
@@ -669,6 +760,7 @@ const SimpleFontData* Font::getFontData(uint32_t codepoint, uint32_t variationSe
 
     if (auto fontData = m_document->fontDataCache()->getFontData(codepoint, variationSelector, m_description.data)) {
         m_fonts.push_back(fontData);
+        clearCodepointCache();
         return fontData.get();
     }
 
@@ -679,7 +771,10 @@ Font::Font(Document* document, const FontDescription& description)
     : m_document(document)
     , m_description(description)
 {
+    bool hasFontFace = false;
     for(const auto& family : description.families) {
+        if(document->styleSheet().hasFontFace(family))
+            hasFontFace = true;
         if(auto font = document->styleSheet().getFontData(family, description.data)) {
             if(m_primaryFont == nullptr)
                 m_primaryFont = font->getFontData(' ', 0);
@@ -694,6 +789,10 @@ Font::Font(Document* document, const FontDescription& description)
             m_fonts.push_back(std::move(fontData));
         }
     }
+
+    if(!hasFontFace) {
+        m_sharedFamilyFonts = m_fonts;
+    }
 }
 
 struct CairoGraphicsManager::Face {
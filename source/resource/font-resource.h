@@ -4,9 +4,14 @@
 #include "global-string.h"
 #include "graphics-manager.h"
 
+#include <array>
+#include <atomic>
+#include <memory>
+#include <tuple>
 #include <variant>
 #include <vector>
 #include <boost/unordered/unordered_flat_map.hpp>
+#include <boost/unordered/unordered_flat_set.hpp>
 #include <mutex>
 
 namespace plutobook {
@@ -17,6 +22,8 @@ namespace plutobook {
         static constexpr ClassKind classKind = ClassKind::Font;
 
         static RefPtr<FontResource> create(Document* document, const Url& url);
+        static RefPtr<FontResource> create(Document* document, const Url& url,
+                                           const ResourceData& resource);
         static bool supportsFormat(std::string_view format);
         FaceHandle face() const { return m_face; }
 
@@ -380,8 +387,13 @@ namespace plutobook {
         return adoptPtr(new SegmentedFontData(std::move(fonts)));
     }
 
+    // Shared by every document in the process so that fontconfig is only
+    // initialized once and matched fonts are reused across documents.
+    // @font-face rules stay per document in CssStyleSheet.
     class FontDataCache {
     public:
+        static FontDataCache* instance();
+
         RefPtr<SimpleFontData>
         getFontData(GlobalString family,
                     const FontDataDescription& description);
@@ -391,15 +403,44 @@ namespace plutobook {
 
         bool isFamilyAvailable(GlobalString family);
 
-        FontDataCache();
+        uint32_t hitCount() const { return m_hitCount; }
+        uint32_t missCount() const { return m_missCount; }
+
         ~FontDataCache();
 
     private:
+        FontDataCache();
         using FontDataKey = std::pair<GlobalString, FontDataDescription>;
 
+        // The table is cleared when it reaches this size, so that a long
+        // running process does not grow it without bound. Fonts still in
+        // use stay alive through their references.
+        static constexpr size_t kMaxFontDataCount = 1024;
+
+        // Fallback fonts are shared by all the codepoints of a Unicode block,
+        // so that fontconfig is queried once per block rather than once per
+        // character. The key is (block, wants color, description).
+        using FallbackKey = std::tuple<int, bool, FontDataDescription>;
+        using FallbackFontList = std::vector<RefPtr<SimpleFontData>>;
+
+        static constexpr size_t kMaxFallbackCount = 4096;
+
+        // Codepoints that no font covers, keyed like FallbackKey but on the
+        // codepoint itself.
+        using MissingKey = std::tuple<uint32_t, bool, FontDataDescription>;
+        static constexpr size_t kMaxMissingCount = 4096;
+
+        RefPtr<SimpleFontData>
+        matchFontData(uint32_t codepoint, bool color,
+                      const FontDataDescription& description);
+
         FcConfig* m_config;
+        std::atomic_uint32_t m_hitCount{0};
+        std::atomic_uint32_t m_missCount{0};
         std::mutex m_mutex;
         boost::unordered_flat_map<FontDataKey, RefPtr<SimpleFontData>> m_table;
+        boost::unordered_flat_map<FallbackKey, FallbackFontList> m_fallbackTable;
+        boost::unordered_flat_set<MissingKey> m_missingTable;
     };
 
     class Font : public RefCounted<Font> {
@@ -425,12 +466,45 @@ namespace plutobook {
         const SimpleFontData* getFontData(uint32_t codepoint,
                                           uint32_t variationSelector);
 
+        // The fonts the families resolved to, in order, when none of them
+        // is an @font-face family. They then come from the process-wide
+        // FontDataCache, as do the fallback and emoji fonts, so text shaped
+        // with them can be shared with other documents. Empty otherwise.
+        const FontDataList& sharedFamilyFonts() const {
+            return m_sharedFamilyFonts;
+        }
+
     private:
         Font(Document* document, const FontDescription& description);
+        const SimpleFontData* findFontData(uint32_t codepoint,
+                                           uint32_t variationSelector);
+        void clearCodepointCache();
+
+        // Lookups are memoized in a direct-mapped table for BMP codepoints
+        // without a variation selector and in a hash map for the rest. Both
+        // are cleared whenever m_fonts grows.
+        struct CodepointCacheEntry {
+            uint32_t codepoint = kInvalidCodepoint;
+            const SimpleFontData* fontData = nullptr;
+        };
+
+        static constexpr uint32_t kInvalidCodepoint = 0xFFFFFFFF;
+        static constexpr size_t kCodepointCacheSize = 256;
+        // The overflow map is emptied when it reaches this size, so that
+        // text spanning many supplementary codepoints cannot grow it
+        // without bound.
+        static constexpr size_t kMaxCodepointOverflowCount = 1024;
+        using CodepointCache =
+            std::array<CodepointCacheEntry, kCodepointCacheSize>;
+
         Document* m_document;
         FontDescription m_description;
         FontDataList m_fonts;
+        FontDataList m_sharedFamilyFonts;
         const SimpleFontData* m_primaryFont{nullptr};
         const SimpleFontData* m_emojiFont{nullptr};
+        std::unique_ptr<CodepointCache> m_codepointCache;
+        boost::unordered_flat_map<uint64_t, const SimpleFontData*>
+            m_codepointOverflow;
     };
 } // namespace plutobook
\ No newline at end of file
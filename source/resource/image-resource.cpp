@@ -14,7 +14,11 @@ namespace plutobook {
 
 RefPtr<ImageResource> ImageResource::create(Document* document, const Url& url)
 {
-    auto resource = ResourceLoader::loadUrl(url, document->customResourceFetcher());
+    return create(document, url, ResourceLoader::loadUrl(url, document->customResourceFetcher()));
+}
+
+RefPtr<ImageResource> ImageResource::create(Document* document, const Url& url, const ResourceData& resource)
+{
     if(resource.isNull())
         return nullptr;
     auto image = decode(resource.content(), resource.contentLength(), resource.mimeType(), resource.textEncoding(), url.base(), document->customResourceFetcher());
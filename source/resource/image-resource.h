@@ -5,6 +5,7 @@
 #include "graphics-manager.h"
 
 #include <memory>
+#include <mutex>
 
 // typedef struct _cairo_surface cairo_surface_t;
 
@@ -17,6 +18,8 @@ namespace plutobook {
         static constexpr ClassKind classKind = ClassKind::Image;
 
         static RefPtr<ImageResource> create(Document* document, const Url& url);
+        static RefPtr<ImageResource> create(Document* document, const Url& url,
+                                            const ResourceData& resource);
         static RefPtr<Image> decode(const char* data, size_t size,
                                     std::string_view mimeType,
                                     std::string_view textEncoding,
@@ -64,8 +67,14 @@ namespace plutobook {
         virtual Size intrinsicSize() const = 0;
         virtual Size size() const = 0;
 
+        // Held across setContainerSize() and the draw call that follows it,
+        // since an Svg image re-lays out its document for each container
+        // size and may be shared by pages painted on different threads.
+        std::mutex& paintMutex() const { return m_paintMutex; }
+
     protected:
         ClassKind m_type;
+        mutable std::mutex m_paintMutex;
     };
 
     class BitmapImage final : public Image {
@@ -1,17 +1,27 @@
 #include "resource.h"
+#include "image-resource.h"
 #include "string-utils.h"
 #include "ident-table.h"
+#include "thread-pool.h"
 
 #include "plutobook.hpp"
 
 #ifdef PLUTOBOOK_HAS_CURL
 #include <curl/curl.h>
-#else
+#endif
+
+#ifdef _WIN32
 #include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 #include <filesystem>
 #include <cstring>
+#include <mutex>
 #include <vector>
 
 namespace plutobook {
@@ -216,6 +226,113 @@ static bool mimeTypeFromPath(std::string& mimeType, std::string_view path)
     return true;
 }
 
+#ifndef _WIN32
+
+struct MappedFile {
+    void* data;
+    size_t size;
+};
+
+static void MappedFileDestroy(void* data)
+{
+    auto file = (MappedFile*)(data);
+    munmap(file->data, file->size);
+    delete file;
+}
+
+#endif // _WIN32
+
+static std::string fileNameFromUrl(std::string_view input)
+{
+    input.remove_prefix(7);
+    if(input.starts_with("localhost/"))
+        input.remove_prefix(9);
+    if (input.size() >= 3 && input[0] == '/' && isAlpha(input[1]) && input[2] == ':') {
+        input.remove_prefix(1);
+    }
+
+    auto filename = percentDecode(input.substr(0, input.rfind('?')));
+#ifdef _WIN32
+    std::replace(filename.begin(), filename.end(), '/', '\\');
+#endif
+    return filename;
+}
+
+// Local files are mapped read-only rather than copied, so that large fonts
+// and images are shared through the page cache instead of being duplicated
+// on the heap of every process that renders them. A mapped file that is
+// truncated while the resource is alive raises SIGBUS on the next access to
+// the lost pages. Pipes and devices cannot be mapped, so they are read.
+static ResourceData loadFileUrl(const std::string& url)
+{
+    auto filename = fileNameFromUrl(url);
+
+    std::string mimeType;
+    std::string textEncoding;
+    mimeTypeFromPath(mimeType, filename);
+
+#ifdef _WIN32
+    std::ifstream in(filename, std::ios::ate | std::ios::binary);
+    if(!in.is_open()) {
+        plutobook_set_error_message("Unable to fetch URL '%s': %s", url.data(), std::strerror(errno));
+        return ResourceData();
+    }
+
+    auto content = ByteArrayCreate(in.tellg());
+    in.seekg(0, std::ios::beg);
+    in.read(content->data(), content->size());
+    in.close();
+
+    return ResourceData(content->data(), content->size(), mimeType, textEncoding, ByteArrayDestroy, content);
+#else
+    auto fd = open(filename.data(), O_RDONLY | O_CLOEXEC);
+    if(fd == -1) {
+        plutobook_set_error_message("Unable to fetch URL '%s': %s", url.data(), std::strerror(errno));
+        return ResourceData();
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) == -1) {
+        plutobook_set_error_message("Unable to fetch URL '%s': %s", url.data(), std::strerror(errno));
+        close(fd);
+        return ResourceData();
+    }
+
+    if(!S_ISREG(st.st_mode) || st.st_size == 0) {
+        auto content = ByteArrayCreate();
+        char buffer[4096];
+        while(true) {
+            auto count = read(fd, buffer, sizeof(buffer));
+            if(count == 0)
+                break;
+            if(count == -1) {
+                if(errno == EINTR)
+                    continue;
+                plutobook_set_error_message("Unable to fetch URL '%s': %s", url.data(), std::strerror(errno));
+                ByteArrayDestroy(content);
+                close(fd);
+                return ResourceData();
+            }
+
+            content->insert(content->end(), buffer, buffer + count);
+        }
+
+        close(fd);
+        return ResourceData(content->data(), content->size(), mimeType, textEncoding, ByteArrayDestroy, content);
+    }
+
+    const auto size = static_cast<size_t>(st.st_size);
+    auto data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) {
+        plutobook_set_error_message("Unable to fetch URL '%s': %s", url.data(), std::strerror(errno));
+        return ResourceData();
+    }
+
+    return ResourceData((const char*)(data), size, mimeType, textEncoding, MappedFileDestroy, new MappedFile{data, size});
+#endif
+}
+
 #ifdef PLUTOBOOK_HAS_CURL
 
 DefaultResourceFetcher::DefaultResourceFetcher()
@@ -257,6 +374,101 @@ DefaultResourceFetcher::~DefaultResourceFetcher()
     curl_global_cleanup();
 }
 
+// Easy handles are kept once a fetch is done, so that the next fetch on a
+// handle reuses its open connections. The DNS and TLS session caches are
+// shared by all of them; libcurl does not support sharing the connection
+// cache between handles used on several threads at once.
+class CurlHandlePool {
+public:
+    static CurlHandlePool* instance();
+
+    CURL* acquire();
+    void release(CURL* curl);
+
+private:
+    CurlHandlePool();
+    ~CurlHandlePool();
+
+    static void lockShare(CURL* curl, curl_lock_data data, curl_lock_access access, void* userptr);
+    static void unlockShare(CURL* curl, curl_lock_data data, void* userptr);
+
+    static constexpr size_t kMaxIdleHandleCount = ResourceLoader::kMaxConcurrentLoads;
+
+    CURLSH* m_share;
+    std::mutex m_shareMutexes[CURL_LOCK_DATA_LAST];
+    std::mutex m_mutex;
+    std::vector<CURL*> m_idleHandles;
+};
+
+CurlHandlePool* CurlHandlePool::instance()
+{
+    static CurlHandlePool pool;
+    return &pool;
+}
+
+CurlHandlePool::CurlHandlePool()
+    : m_share(curl_share_init())
+{
+    curl_share_setopt(m_share, CURLSHOPT_LOCKFUNC, lockShare);
+    curl_share_setopt(m_share, CURLSHOPT_UNLOCKFUNC, unlockShare);
+    curl_share_setopt(m_share, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+}
+
+CurlHandlePool::~CurlHandlePool()
+{
+    for(auto curl : m_idleHandles)
+        curl_easy_cleanup(curl);
+    curl_share_cleanup(m_share);
+}
+
+CURL* CurlHandlePool::acquire()
+{
+    CURL* curl = nullptr;
+    {
+        std::lock_guard guard(m_mutex);
+        if(!m_idleHandles.empty()) {
+            curl = m_idleHandles.back();
+            m_idleHandles.pop_back();
+        }
+    }
+
+    if(curl == nullptr)
+        curl = curl_easy_init();
+    curl_easy_setopt(curl, CURLOPT_SHARE, m_share);
+    return curl;
+}
+
+void CurlHandlePool::release(CURL* curl)
+{
+    // Resetting clears the options but keeps the handle's connection cache
+    // and leaves the share attached, so setting it again on acquire is a
+    // no-op.
+    curl_easy_reset(curl);
+    {
+        std::lock_guard guard(m_mutex);
+        if(m_idleHandles.size() < kMaxIdleHandleCount) {
+            m_idleHandles.push_back(curl);
+            return;
+        }
+    }
+
+    curl_easy_cleanup(curl);
+}
+
+void CurlHandlePool::lockShare(CURL* curl, curl_lock_data data, curl_lock_access access, void* userptr)
+{
+    auto pool = static_cast<CurlHandlePool*>(userptr);
+    pool->m_shareMutexes[data].lock();
+}
+
+void CurlHandlePool::unlockShare(CURL* curl, curl_lock_data data, void* userptr)
+{
+    auto pool = static_cast<CurlHandlePool*>(userptr);
+    pool->m_shareMutexes[data].unlock();
+}
+
 static size_t writeCallback(const char* contents, size_t blockSize, size_t numberOfBlocks, ByteArray* response)
 {
     size_t totalSize = blockSize * numberOfBlocks;
@@ -268,11 +480,14 @@ ResourceData DefaultResourceFetcher::fetchUrl(const std::string& url)
 {
     if(startswith(url, "data:", false))
         return loadDataUrl(percentDecode(url));
+    if(startswith(url, "file://", false))
+        return loadFileUrl(url);
     std::string mimeType;
     std::string textEncoding;
     auto content = ByteArrayCreate();
 
-    auto curl = curl_easy_init();
+    auto pool = CurlHandlePool::instance();
+    auto curl = pool->acquire();
     curl_easy_setopt(curl, CURLOPT_URL, url.data());
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, content);
@@ -307,7 +522,7 @@ ResourceData DefaultResourceFetcher::fetchUrl(const std::string& url)
         }
     }
 
-    curl_easy_cleanup(curl);
+    pool->release(curl);
     if(response == CURLE_OK)
         return ResourceData(content->data(), content->size(), mimeType, textEncoding, ByteArrayDestroy, content);
     plutobook_set_error_message("Unable to fetch URL '%s': %s", url.data(), curl_easy_strerror(response));
@@ -324,38 +539,10 @@ ResourceData DefaultResourceFetcher::fetchUrl(const std::string& url)
 {
     if(startswith(url, "data:", false))
         return loadDataUrl(percentDecode(url));
-    std::string_view input(url);
-    if(!startswith(input, "file://", false)) {
-        plutobook_set_error_message("Unable to fetch URL '%s': Unsupported protocol", url.data());
-        return ResourceData();
-    }
-
-    input.remove_prefix(7);
-    if (input.size() >= 3 && input[0] == '/' && isAlpha(input[1]) && input[2] == ':') {
-        input.remove_prefix(1);
-    }
-
-    auto filename = percentDecode(input.substr(0, input.rfind('?')));
-#ifdef _WIN32
-    std::replace(filename.begin(), filename.end(), '/', '\\');
-#endif
-
-    std::ifstream in(filename, std::ios::ate | std::ios::binary);
-    if(!in.is_open()) {
-        plutobook_set_error_message("Unable to fetch URL '%s': %s", url.data(), std::strerror(errno));
-        return ResourceData();
-    }
-
-    std::string mimeType;
-    std::string textEncoding;
-    mimeTypeFromPath(mimeType, filename);
-
-    auto content = ByteArrayCreate(in.tellg());
-    in.seekg(0, std::ios::beg);
-    in.read(content->data(), content->size());
-    in.close();
-
-    return ResourceData(content->data(), content->size(), mimeType, textEncoding, ByteArrayDestroy, content);
+    if(startswith(url, "file://", false))
+        return loadFileUrl(url);
+    plutobook_set_error_message("Unable to fetch URL '%s': Unsupported protocol", url.data());
+    return ResourceData();
 }
 
 #endif // PLUTOBOOK_HAS_CURL
@@ -369,6 +556,20 @@ ResourceData ResourceLoader::loadUrl(const Url& url, ResourceFetcher* customFetc
     return customFetcher->fetchUrl(url.value());
 }
 
+std::vector<ResourceData> ResourceLoader::loadUrls(const std::vector<Url>& urls, std::vector<std::string>& errorMessages, ResourceFetcher* customFetcher)
+{
+    std::vector<ResourceData> resources(urls.size());
+    errorMessages.assign(urls.size(), std::string());
+    parallelFor(urls.size(), kMaxConcurrentLoads, [&](size_t index) {
+        resources[index] = loadUrl(urls[index], customFetcher);
+        if(resources[index].isNull()) {
+            errorMessages[index] = plutobook_get_error_message();
+        }
+    });
+
+    return resources;
+}
+
 Url ResourceLoader::baseUrl()
 {
     auto path = std::filesystem::current_path().generic_string();
@@ -388,4 +589,184 @@ DefaultResourceFetcher* defaultResourceFetcher()
     return &defaultFetcher;
 }
 
+ResourceCache* ResourceCache::instance()
+{
+    static ResourceCache cache;
+    return &cache;
+}
+
+RefPtr<Resource> ResourceCache::find(const Url& url, Resource::Type type, ResourceFetcher* fetcher)
+{
+    std::lock_guard guard(m_mutex);
+    if(m_capacity == 0)
+        return nullptr;
+    auto it = m_urls.find(UrlKey{url, type, fetcher});
+    if(it == m_urls.end())
+        return nullptr;
+    if(it->second.validator != validatorForUrl(url)) {
+        remove(it->second.entry);
+        return nullptr;
+    }
+
+    ++m_hitCount;
+    m_entries.splice(m_entries.begin(), m_entries, it->second.entry);
+    return it->second.entry->resource;
+}
+
+RefPtr<Resource> ResourceCache::findContent(const ResourceData& data, Resource::Type type)
+{
+    std::lock_guard guard(m_mutex);
+    if(m_capacity == 0)
+        return nullptr;
+    auto key = contentKey(data, type);
+    auto it = key ? m_contents.find(*key) : m_contents.end();
+    if(it == m_contents.end() || !isSameContent(it->second->data, data)) {
+        ++m_missCount;
+        return nullptr;
+    }
+
+    ++m_hitCount;
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return it->second->resource;
+}
+
+void ResourceCache::add(const Url& url, Resource::Type type, ResourceFetcher* fetcher, const ResourceData& data, const RefPtr<Resource>& resource)
+{
+    std::lock_guard guard(m_mutex);
+    if(m_capacity == 0 || resource == nullptr)
+        return;
+    // An svg image holds a document that is laid out again for every
+    // container size it is drawn at, so it cannot be shared between
+    // documents, which may be rendered on different threads.
+    if(auto imageResource = to<ImageResource>(resource.get())) {
+        auto image = imageResource->image();
+        if(image && is<SvgImage>(*image)) {
+            return;
+        }
+    }
+
+    auto content = contentKey(data, type);
+    auto entry = m_entries.end();
+    if(content.has_value()) {
+        auto it = m_contents.find(*content);
+        if(it != m_contents.end()) {
+            if(isSameContent(it->second->data, data)) {
+                entry = it->second;
+            } else {
+                content.reset();
+            }
+        }
+    }
+
+    if(entry == m_entries.end()) {
+        size_t cost = data.contentLength();
+        if(auto imageResource = to<ImageResource>(resource.get())) {
+            if(auto image = to<BitmapImage>(imageResource->image().get())) {
+                const auto size = image->size();
+                cost += 4 * static_cast<size_t>(size.w) * static_cast<size_t>(size.h);
+            }
+        }
+
+        if(cost > m_capacity)
+            return;
+        evict(m_capacity - cost);
+        entry = m_entries.emplace(m_entries.begin(), resource, cost, std::vector<UrlKey>(), content);
+        if(content.has_value()) {
+            entry->data = data;
+            m_contents.emplace(*content, entry);
+        }
+        m_size += cost;
+    }
+
+    // Data urls carry their content, which is found by its hash instead.
+    if(url.protocolIs("data"))
+        return;
+    UrlKey key{url, type, fetcher};
+    if(auto it = m_urls.find(key); it != m_urls.end()) {
+        if(it->second.entry == entry)
+            return;
+        remove(it->second.entry);
+    }
+
+    entry->urls.push_back(key);
+    m_urls.emplace(std::move(key), UrlEntry{entry, validatorForUrl(url)});
+}
+
+void ResourceCache::setCapacity(size_t capacity)
+{
+    std::lock_guard guard(m_mutex);
+    m_capacity = capacity;
+    evict(capacity);
+}
+
+size_t ResourceCache::capacity() const
+{
+    std::lock_guard guard(m_mutex);
+    return m_capacity;
+}
+
+size_t ResourceCache::size() const
+{
+    std::lock_guard guard(m_mutex);
+    return m_size;
+}
+
+uint32_t ResourceCache::hitCount() const
+{
+    std::lock_guard guard(m_mutex);
+    return m_hitCount;
+}
+
+uint32_t ResourceCache::missCount() const
+{
+    std::lock_guard guard(m_mutex);
+    return m_missCount;
+}
+
+ResourceCache::Validator ResourceCache::validatorForUrl(const Url& url)
+{
+    Validator validator;
+    if(!url.protocolIs("file"))
+        return validator;
+    std::error_code ec;
+    const std::filesystem::path path(fileNameFromUrl(url.value()));
+    validator.modified = std::filesystem::last_write_time(path, ec);
+    validator.size = std::filesystem::file_size(path, ec);
+    return validator;
+}
+
+std::optional<ResourceCache::ContentKey> ResourceCache::contentKey(const ResourceData& data, Resource::Type type)
+{
+    if(data.isNull())
+        return std::nullopt;
+    std::string_view content(data.content(), data.contentLength());
+    return ContentKey{type, boost::hash<std::string_view>{}(content), content.length()};
+}
+
+bool ResourceCache::isSameContent(const ResourceData& a, const ResourceData& b)
+{
+    if(a.isNull() || b.isNull())
+        return false;
+    // The mime type and encoding decide how the same bytes are decoded.
+    return a.mimeType() == b.mimeType() && a.textEncoding() == b.textEncoding()
+        && std::string_view(a.content(), a.contentLength()) == std::string_view(b.content(), b.contentLength());
+}
+
+void ResourceCache::evict(size_t capacity)
+{
+    while(m_size > capacity) {
+        remove(std::prev(m_entries.end()));
+    }
+}
+
+void ResourceCache::remove(EntryList::iterator entry)
+{
+    for(const auto& url : entry->urls)
+        m_urls.erase(url);
+    if(entry->content.has_value())
+        m_contents.erase(*entry->content);
+    m_size -= entry->cost;
+    m_entries.erase(entry);
+}
+
 } // namespace plutobook
@@ -4,6 +4,15 @@
 #include "heap-string.h"
 #include "url.h"
 
+#include "plutobook.hpp"
+
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <vector>
+#include <boost/unordered/unordered_flat_map.hpp>
+
 namespace plutobook {
     class Resource : public RefCounted<Resource> {
     public:
@@ -20,14 +29,125 @@ namespace plutobook {
         ClassKind m_type;
     };
 
-    class ResourceData;
-    class ResourceFetcher;
-
     class ResourceLoader {
     public:
         static ResourceData loadUrl(const Url& url,
                                     ResourceFetcher* customFetcher = nullptr);
+        // Loads the urls concurrently on the shared thread pool, with at
+        // most kMaxConcurrentLoads requests in flight, and returns their
+        // data in the same order.
+        // The error message of each failed load is stored at its index in
+        // errorMessages, since error messages are kept per thread.
+        static std::vector<ResourceData>
+        loadUrls(const std::vector<Url>& urls,
+                 std::vector<std::string>& errorMessages,
+                 ResourceFetcher* customFetcher = nullptr);
+        static constexpr size_t kMaxConcurrentLoads = 8;
         static Url completeUrl(std::string_view value);
         static Url baseUrl();
     };
+
+    // Decoded resources kept across the documents of the process, within a
+    // byte budget, evicting the least recently used first. Entries are found
+    // by url and, once the data is loaded, by a hash of the content, so that
+    // the same bytes served from several urls are decoded once. Local files
+    // are checked for changes on every hit; the fetchers report no
+    // validators for remote resources, which are kept until evicted.
+    class ResourceCache {
+    public:
+        static ResourceCache* instance();
+
+        RefPtr<Resource> find(const Url& url, Resource::Type type,
+                              ResourceFetcher* fetcher);
+        RefPtr<Resource> findContent(const ResourceData& data,
+                                     Resource::Type type);
+        void add(const Url& url, Resource::Type type, ResourceFetcher* fetcher,
+                 const ResourceData& data, const RefPtr<Resource>& resource);
+
+        // A capacity of zero, the default, disables and empties the cache.
+        void setCapacity(size_t capacity);
+        size_t capacity() const;
+        size_t size() const;
+
+        uint32_t hitCount() const;
+        uint32_t missCount() const;
+
+    private:
+        ResourceCache() = default;
+
+        struct UrlKey {
+            Url url;
+            Resource::Type type;
+            ResourceFetcher* fetcher;
+
+            bool operator==(const UrlKey& other) const = default;
+
+            friend std::size_t hash_value(const UrlKey& self) {
+                std::size_t seed = 0;
+                boost::hash_combine(seed, self.url);
+                boost::hash_combine(seed, self.type);
+                boost::hash_combine(seed, self.fetcher);
+                return seed;
+            }
+        };
+
+        struct ContentKey {
+            Resource::Type type;
+            std::size_t hash;
+            std::size_t length;
+
+            bool operator==(const ContentKey& other) const = default;
+
+            friend std::size_t hash_value(const ContentKey& self) {
+                std::size_t seed = self.hash;
+                boost::hash_combine(seed, self.type);
+                boost::hash_combine(seed, self.length);
+                return seed;
+            }
+        };
+
+        // The modification time and size of a local file when it was
+        // loaded; empty for every other url.
+        struct Validator {
+            std::filesystem::file_time_type modified;
+            std::uintmax_t size{0};
+
+            bool operator==(const Validator& other) const = default;
+        };
+
+        struct Entry {
+            RefPtr<Resource> resource;
+            size_t cost;
+            std::vector<UrlKey> urls;
+            std::optional<ContentKey> content;
+            // Compared on a content hit, so that two contents with the
+            // same hash never share a resource.
+            ResourceData data;
+        };
+
+        using EntryList = std::list<Entry>;
+
+        struct UrlEntry {
+            EntryList::iterator entry;
+            Validator validator;
+        };
+
+        static Validator validatorForUrl(const Url& url);
+        static std::optional<ContentKey> contentKey(const ResourceData& data,
+                                                    Resource::Type type);
+        static bool isSameContent(const ResourceData& a,
+                                  const ResourceData& b);
+
+        void evict(size_t capacity);
+        void remove(EntryList::iterator entry);
+
+        mutable std::mutex m_mutex;
+        EntryList m_entries;
+        boost::unordered_flat_map<UrlKey, UrlEntry> m_urls;
+        boost::unordered_flat_map<ContentKey, EntryList::iterator> m_contents;
+        size_t m_capacity{0};
+        size_t m_size{0};
+        uint32_t m_hitCount{0};
+        uint32_t m_missCount{0};
+    };
 } // namespace plutobook
\ No newline at end of file
@@ -8,7 +8,11 @@ namespace plutobook {
 
 RefPtr<TextResource> TextResource::create(Document* document, const Url& url)
 {
-    auto resource = ResourceLoader::loadUrl(url, document->customResourceFetcher());
+    return create(document, url, ResourceLoader::loadUrl(url, document->customResourceFetcher()));
+}
+
+RefPtr<TextResource> TextResource::create(Document* document, const Url& url, const ResourceData& resource)
+{
     if(resource.isNull())
         return nullptr;
     return adoptPtr(new TextResource(decode(resource.content(), resource.contentLength(), resource.mimeType(), resource.textEncoding())));
@@ -12,6 +12,8 @@ namespace plutobook {
         static constexpr ClassKind classKind = ClassKind::Text;
 
         static RefPtr<TextResource> create(Document* document, const Url& url);
+        static RefPtr<TextResource> create(Document* document, const Url& url,
+                                           const ResourceData& resource);
         static std::string_view decode(const char* data, size_t length,
                                        std::string_view mimeType,
                                        std::string_view textEncoding);
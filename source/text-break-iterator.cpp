@@ -6,14 +6,37 @@
 
 namespace plutobook {
 
+// Written as a plain reduction so that the compiler can vectorize it.
+static bool isAllAscii(const UChar* characters, int length)
+{
+    UChar bits = 0;
+    for(int i = 0; i < length; ++i)
+        bits |= characters[i];
+    return bits < 0x80;
+}
+
 CharacterBreakIterator::CharacterBreakIterator(const UString& text)
-    : m_iterator(getIterator())
+    : m_characters(text.getBuffer())
+    , m_length(text.length())
 {
-    m_iterator->setText(text);
+    // In ASCII text every character is a cluster of its own, except for
+    // CR LF, so ICU is only needed when something else shows up.
+    if(!isAllAscii(m_characters, m_length)) {
+        m_iterator = getIterator();
+        m_iterator->setText(text);
+    }
 }
 
 int CharacterBreakIterator::nextBreakOpportunity(int offset, int end) const
 {
+    if(m_iterator == nullptr) {
+        if(offset >= m_length)
+            return end;
+        if(m_characters[offset] == '\r' && offset + 1 < m_length && m_characters[offset + 1] == '\n')
+            return offset + 2;
+        return offset + 1;
+    }
+
     auto position = m_iterator->following(offset);
     if(position == UBRK_DONE)
         return end;
@@ -15,7 +15,9 @@ public:
 
 private:
     static icu::BreakIterator* getIterator();
-    icu::BreakIterator* m_iterator;
+    icu::BreakIterator* m_iterator{nullptr};
+    const UChar* m_characters;
+    int m_length;
 };
 
 class LineBreakIterator {
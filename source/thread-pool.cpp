@@ -0,0 +1,53 @@
+#include "thread-pool.h"
+
+namespace plutobook {
+
+ThreadPool* ThreadPool::instance()
+{
+    static ThreadPool pool;
+    return &pool;
+}
+
+void ThreadPool::post(const std::function<void()>& task, size_t count)
+{
+    {
+        std::lock_guard guard(m_mutex);
+        while(m_threads.size() < count)
+            m_threads.emplace_back(&ThreadPool::run, this);
+        m_tasks.insert(m_tasks.end(), count, task);
+    }
+
+    m_condition.notify_all();
+}
+
+void ThreadPool::run()
+{
+    while(true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+            if(m_tasks.empty())
+                return;
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+
+        task();
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard guard(m_mutex);
+        m_stopping = true;
+    }
+
+    m_condition.notify_all();
+    for(auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+} // namespace plutobook
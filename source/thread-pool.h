@@ -0,0 +1,120 @@
+#ifndef PLUTOBOOK_THREADPOOL_H
+#define PLUTOBOOK_THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace plutobook {
+
+// Worker threads kept for the lifetime of the process, so that painting
+// pages and fetching resources in parallel do not start and join new
+// threads on every call. The pool grows to the largest number of helpers
+// requested so far, and is shared by every caller of parallelFor.
+class ThreadPool {
+public:
+    static ThreadPool* instance();
+
+    void post(const std::function<void()>& task, size_t count);
+
+private:
+    ThreadPool() = default;
+    ~ThreadPool();
+    void run();
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<std::function<void()>> m_tasks;
+    std::vector<std::thread> m_threads;
+    bool m_stopping{false};
+};
+
+// Calls func for every index below count, on the calling thread and on up
+// to threadCount - 1 pool threads, and returns once every call is done.
+template<typename Function>
+void parallelFor(size_t count, unsigned threadCount, Function func)
+{
+    threadCount = std::min<size_t>(threadCount, count);
+    if(threadCount <= 1) {
+        for(size_t index = 0; index < count; ++index)
+            func(index);
+        return;
+    }
+
+    // The pool may be busy with other callers, so a helper can start after
+    // the caller has taken every index and returned. The job is closed
+    // then, and such a helper leaves without touching the caller's state.
+    // An exception thrown by func stops the remaining indices from being
+    // taken and is rethrown on the caller once every helper has left.
+    struct Job {
+        std::atomic_size_t nextIndex{0};
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::exception_ptr exception;
+        unsigned runningCount{0};
+        bool closed{false};
+    };
+
+    // Closes the job and waits for the running helpers on every way out of
+    // the caller's scope, since they still reference func and the caller's
+    // stack.
+    struct JobCloser {
+        ~JobCloser() {
+            std::unique_lock lock(job->mutex);
+            job->closed = true;
+            job->condition.wait(lock, [this] { return job->runningCount == 0; });
+        }
+
+        Job* job;
+    };
+
+    auto job = std::make_shared<Job>();
+    auto worker = [&]() {
+        try {
+            for(auto index = job->nextIndex++; index < count; index = job->nextIndex++) {
+                func(index);
+            }
+        } catch(...) {
+            job->nextIndex = count;
+            std::lock_guard guard(job->mutex);
+            if(job->exception == nullptr) {
+                job->exception = std::current_exception();
+            }
+        }
+    };
+
+    auto helper = [job, &worker]() {
+        {
+            std::lock_guard guard(job->mutex);
+            if(job->closed)
+                return;
+            ++job->runningCount;
+        }
+
+        worker();
+        std::lock_guard guard(job->mutex);
+        --job->runningCount;
+        job->condition.notify_all();
+    };
+
+    {
+        JobCloser closer{job.get()};
+        ThreadPool::instance()->post(helper, threadCount - 1);
+        worker();
+    }
+
+    if(job->exception) {
+        std::rethrow_exception(job->exception);
+    }
+}
+
+} // namespace plutobook
+
+#endif // PLUTOBOOK_THREADPOOL_H
@@ -157,12 +157,17 @@ namespace plutobook {
         }
 
         friend bool update(UIContext* ui) {
-            if (ui->m_document->isDirty()) {
-                ui->m_document->build();
-                ui->m_document->layout();
-                return true;
-            }
-            return false;
+            return ui->m_document->update();
+        }
+
+        // Counts from the last update(): the elements whose style was
+        // recomputed, and the boxes laid out again (zero when only
+        // paint-time properties changed).
+        friend void getUpdateStats(const UIContext* ui,
+                                   unsigned& restyledBoxes,
+                                   unsigned& relaidOutBoxes) {
+            restyledBoxes = ui->m_document->restyledBoxCount();
+            relaidOutBoxes = ui->m_document->relaidOutBoxCount();
         }
 
         friend void output(UIContext* ui, FILE* fd) {
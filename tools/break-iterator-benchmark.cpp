@@ -0,0 +1,98 @@
+#include "text-break-iterator.h"
+#include "argparser.h"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+
+using namespace plutobook;
+
+static const char kParagraph[] =
+    "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor "
+    "incididunt ut labore et dolore magna aliqua. Ut enim ad minim veniam, quis nostrud "
+    "exercitation ullamco laboris nisi ut aliquip ex ea commodo consequat (see p. 42-47).\r\n";
+
+template<typename Function>
+static double measure(int iterations, Function func)
+{
+    size_t count = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < iterations; ++i)
+        count += func();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    if(count == 0)
+        std::cerr << "WARNING: no breaks found" << std::endl;
+    return elapsed.count();
+}
+
+static void report(const char* name, double asciiTime, double icuTime)
+{
+    std::cout << name << ": ascii " << asciiTime << " ms, icu " << icuTime << " ms";
+    if(asciiTime > 0.0)
+        std::cout << " (" << icuTime / asciiTime << "x)";
+    std::cout << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    int repeat = 256;
+    int iterations = 20;
+
+    ArgDesc args[] = {
+        {"--repeat", ArgType::Int, &repeat, nullptr, "Specify how many times the sample paragraph is repeated"},
+        {"--iterations", ArgType::Int, &iterations, nullptr, "Specify the number of passes over the text"},
+        {nullptr}
+    };
+
+    parseArgs("break-iterator-benchmark", "Compare the ASCII and ICU text break paths", args, argc, argv);
+
+    UString text;
+    for(int i = 0; i < repeat; ++i)
+        text.append(UString::fromUTF8(kParagraph));
+    const auto length = text.length();
+
+    // CharacterBreakIterator takes its ASCII path for this text; the ICU
+    // character iterator is what it falls back to for other text.
+    auto asciiClusters = measure(iterations, [&] {
+        CharacterBreakIterator iterator(text);
+        size_t count = 0;
+        for(int offset = 0; offset < length; offset = iterator.nextBreakOpportunity(offset, length))
+            ++count;
+        return count;
+    });
+
+    auto icuClusters = measure(iterations, [&] {
+        UErrorCode status = U_ZERO_ERROR;
+        std::unique_ptr<icu::BreakIterator> iterator(icu::BreakIterator::createCharacterInstance(icu::Locale::getDefault(), status));
+        iterator->setText(text);
+        size_t count = 0;
+        for(auto offset = iterator->first(); offset != UBRK_DONE && offset < length; offset = iterator->next())
+            ++count;
+        return count;
+    });
+
+    // LineBreakIterator resolves ASCII pairs from its table and only sets
+    // up ICU for other characters.
+    auto asciiLines = measure(iterations, [&] {
+        LineBreakIterator iterator(text);
+        size_t count = 0;
+        for(uint32_t offset = 0; offset < uint32_t(length); offset = iterator.nextBreakOpportunity(offset + 1))
+            ++count;
+        return count;
+    });
+
+    auto icuLines = measure(iterations, [&] {
+        UErrorCode status = U_ZERO_ERROR;
+        std::unique_ptr<icu::BreakIterator> iterator(icu::BreakIterator::createLineInstance(icu::Locale::getDefault(), status));
+        iterator->setText(text);
+        size_t count = 0;
+        for(auto offset = iterator->first(); offset != UBRK_DONE && offset < length; offset = iterator->next())
+            ++count;
+        return count;
+    });
+
+    std::cout << iterations << " passes over " << length << " characters" << std::endl;
+    report("clusters", asciiClusters, icuClusters);
+    report("line breaks", asciiLines, icuLines);
+    return 0;
+}
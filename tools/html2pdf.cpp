@@ -1,6 +1,7 @@
 #include "plutobook.hpp"
 #include "argparser.h"
 
+#include <algorithm>
 #include <iostream>
 
 using namespace plutobook;
@@ -107,6 +108,9 @@ int main(int argc, char* argv[])
     int page_end = kMaxPageCount;
     int page_step = 1;
 
+    int threads = 1;
+    bool stream = false;
+
     const char* title = "";
     const char* subject = "";
     const char* author = "";
@@ -134,6 +138,9 @@ int main(int argc, char* argv[])
         {"--page-end", ArgType::Int, &page_end, nullptr, "Specify the last page number to print"},
         {"--page-step", ArgType::Int, &page_step, nullptr, "Specify the page step value"},
 
+        {"--threads", ArgType::Int, &threads, nullptr, "Specify the number of render threads (0 for one per core)"},
+        {"--stream", ArgType::Flag, &stream, nullptr, "Write pages one at a time and free them (requires a positive page step)"},
+
         {"--user-style", ArgType::String, &user_style, nullptr, "Specify the user-defined CSS style"},
         {"--user-script", ArgType::String, &user_script, nullptr, "Specify the user-defined JavaScript"},
 
@@ -178,17 +185,27 @@ int main(int argc, char* argv[])
     book.setAuthor(author);
     book.setKeywords(keywords);
     book.setCreator(creator);
+    book.setRenderThreadCount(std::max(0, threads));
 
     if(!book.loadUrl(input, user_style, user_script)) {
         std::cerr << "ERROR: " << plutobook_get_error_message() << std::endl;
         return 2;
     }
 
-    if(!book.writeToPdf(output, page_start, page_end, page_step)) {
+    if(stream) {
+        if(!book.streamToPdf(output, page_start, page_end, page_step)) {
+            std::cerr << "ERROR: " << plutobook_get_error_message() << std::endl;
+            return 3;
+        }
+    } else if(!book.writeToPdf(output, page_start, page_end, page_step)) {
         std::cerr << "ERROR: " << plutobook_get_error_message() << std::endl;
         return 3;
     }
 
     std::cout << "Generated PDF file: " << output << std::endl;
+    if(stream) {
+        std::cout << "Peak memory usage: " << peakMemoryUsage() / (1024 * 1024) << " MiB" << std::endl;
+    }
+
     return 0;
 }
@@ -1,6 +1,7 @@
 #include "plutobook.hpp"
 #include "argparser.h"
 
+#include <algorithm>
 #include <iostream>
 
 using namespace plutobook;
@@ -19,6 +20,8 @@ int main(int argc, char* argv[])
     float width = -1;
     float height = -1;
 
+    int threads = 1;
+
     ArgDesc args[] = {
         {"input", ArgType::String, &input, nullptr, "Specify the input HTML filename or URL"},
         {"output", ArgType::String, &output, nullptr, "Specify the output PNG filename"},
@@ -29,6 +32,8 @@ int main(int argc, char* argv[])
         {"--width", ArgType::Length, &width, nullptr, "Specify the output image width (eg. 800px)"},
         {"--height", ArgType::Length, &height, nullptr, "Specify the output image height (eg. 600px)"},
 
+        {"--threads", ArgType::Int, &threads, nullptr, "Specify the number of render threads (0 for one per core)"},
+
         {"--user-style", ArgType::String, &user_style, nullptr, "Specify the user-defined CSS style"},
         {"--user-script", ArgType::String, &user_script, nullptr, "Specify the user-defined JavaScript"},
         {nullptr}
@@ -38,6 +43,7 @@ int main(int argc, char* argv[])
 
     PageSize size(viewport_width, viewport_height);
     Book book(size, PageMargins::None, MediaType::Screen);
+    book.setRenderThreadCount(std::max(0, threads));
     if(!book.loadUrl(input, user_style, user_script)) {
         std::cerr << "ERROR: " << plutobook_get_error_message() << std::endl;
         return 2;